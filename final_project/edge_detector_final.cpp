@@ -1,43 +1,188 @@
 #include <opencv2/opencv.hpp>
 #include <kompute/Kompute.hpp>
 
+#include "frame_source.hpp"
+#include "gpu_engine.hpp"
+#include "hybrid_rows.hpp"
+#include "metrics.hpp"
+#include "stage_histogram.hpp"
 #include "vulkan_display.hpp"
 
+#include <cstdlib>
 #include <cstring>
-#include <fstream>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <thread>
 #include <vector>
 
 using namespace cv;
 using namespace std;
 
-// Helper to load SPIR-V files
-vector<uint32_t> load_spirv(const string& filename)
+// Taken during static initialisation so time-to-first-frame includes device and pipeline setup
+static const int64 processStartTicks = getTickCount();
+
+static double ms_since(int64 startTicks)
+{
+    return (getTickCount() - startTicks) * 1000.0 / getTickFrequency();
+}
+
+struct Options
+{
+    string videoPath = "0";  // file, camera, or "synth:WxH[@fps][:pattern[:frames]]" (lab6 frame_source.hpp)
+    bool headless = false;   // compute-only device, no window or swapchain
+    string outputPath;       // headless: optional edge video written from readback
+    string shader = "fused"; // "fused" (edge_detector.comp), "tiled" (edge_detector_tiled.comp)
+                             // or "graph" (grayscale, blur, Sobel, NMS, threshold passes)
+    string input = "bgr";    // upload layout: "rgba", "bgr" or "gray"
+    int framesInFlight = 2;  // frames submitted to the GPU before waiting on the oldest
+    string workgroup = "auto"; // "WxH", or "auto" to time the candidate shapes at startup
+    uint32_t threshold = 40;   // graph: 0-255 edge cutoff, 0 keeps the magnitudes
+    int batch = 1;             // headless fused/tiled: frames per dispatch, one per z slice of the grid
+    string outputFormat = "auto"; // "rgba", "gray8", "mask" (fused/graph), or "auto": gray8 when
+                                  // headless, rgba with a window (no expansion pass needed)
+    bool hybrid = false;       // headless: GPU computes the top rows, CPU threads the rest
+    int cpuThreads = 0;        // hybrid: CPU worker threads, 0 for one per core but one
+    int streams = 1;           // headless: copies of the input processed side by side
+    int queues = 1;            // headless: compute queues the streams are spread over
+    int queueFamily = 0;       // headless with --queues > 1: queue family to take them from
+    string metricsAddress;     // "[host:]port" or "unix:path" to serve live Prometheus metrics on
+};
+
+// CLI-side state of one engine frame
+struct FrameSlot
+{
+    GpuFrame* gpu = nullptr;
+    uint64_t presentTicket = 0; // the output is being copied to the swapchain until this completes
+
+    // --hybrid: the GPU writes output rows [0, gpu->rows), CPU threads the rest into cpuEdges
+    Mat cpuEdges;
+    int64 submitTicks = 0;
+    bool cpuStarted = false;
+};
+
+// One input video and the engine frames it cycles through
+struct Stream
+{
+    frameSource_t source;
+    vector<FrameSlot> slots;
+    size_t frameIndex = 0;
+    bool done = false;
+};
+
+// BT.709 gray with the same fixed-point weights as the lab5/lab6 NEON kernel;
+// written as a plain loop so -O3 vectorizes it for the host ISA.
+void bgr_to_gray(const Mat& bgr, uchar* dst)
+{
+    for (int y = 0; y < bgr.rows; ++y) {
+        const uchar* src = bgr.ptr<uchar>(y);
+        uchar* out = dst + static_cast<size_t>(y) * bgr.cols;
+        for (int x = 0; x < bgr.cols; ++x) {
+            out[x] = static_cast<uchar>((19 * src[3 * x] + 183 * src[3 * x + 1] + 54 * src[3 * x + 2]) >> 8);
+        }
+    }
+}
+
+// Converts a decoded BGR frame into a slot's mapped input memory in the layout the
+// shader was specialized for. inputView wraps the tensor memory, so nothing is reallocated.
+void store_frame(const Mat& frame, InputFormat format, Mat& inputView)
+{
+    // inputView has the configured size; bgr_to_gray writes through its pointer unchecked
+    if (frame.size() != inputView.size() || frame.type() != CV_8UC3) {
+        throw runtime_error("Error: Frame resolution changed during processing.");
+    }
+    switch (format) {
+    case InputFormat::Rgba:
+        cvtColor(frame, inputView, COLOR_BGR2RGBA);
+        break;
+    case InputFormat::Bgr:
+        frame.copyTo(inputView);
+        break;
+    case InputFormat::Gray:
+        bgr_to_gray(frame, inputView.data);
+        break;
+    }
+}
+
+// Decodes the next frame straight into a slot's mapped input memory. For BGR the decoder's
+// own output conversion writes into the tensor, so only decodeTime gets a sample; the other
+// formats convert from one reused scratch frame. Returns false at the end of the stream.
+bool read_frame(frameSource_t& source, InputFormat format, Mat& decodeScratch, Mat& inputView,
+                StageHistogram& decodeTime, StageHistogram& convertTime)
+{
+    uchar* const mapped = inputView.data;
+    const int64 decodeStart = getTickCount();
+    if (format == InputFormat::Bgr) {
+        if (!source_read(&source, inputView)) {
+            return false;
+        }
+        decodeTime.add(ms_since(decodeStart));
+    }
+    else {
+        if (!source_read(&source, decodeScratch)) {
+            return false;
+        }
+        decodeTime.add(ms_since(decodeStart));
+        const int64 convertStart = getTickCount();
+        store_frame(decodeScratch, format, inputView);
+        convertTime.add(ms_since(convertStart));
+    }
+
+    // A different size or type would make OpenCV reallocate instead of writing in place.
+    if (inputView.data != mapped) {
+        throw runtime_error("Error: Frame resolution changed during processing.");
+    }
+    return true;
+}
+
+// Unpacks the first `rows` rows of shader output into an 8-bit gray frame; mask bits become 0/255
+void unpack_output(const uint32_t* packed, OutputFormat format, Mat& gray, int rows)
 {
-    ifstream file(filename, ios::binary | ios::ate);
-    if (!file.is_open()) {
-        throw runtime_error("Failed to open SPIR-V file: " + filename);
-    }
-    const size_t size = static_cast<size_t>(file.tellg());
-    file.seekg(0, ios::beg);
-    vector<uint32_t> buffer(size / sizeof(uint32_t));
-    file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(size));
-    return buffer;
+    const size_t rowWords = output_row_words(format, static_cast<uint32_t>(gray.cols));
+    for (int y = 0; y < rows; ++y) {
+        const uint32_t* src = packed + static_cast<size_t>(y) * rowWords;
+        uchar* dst = gray.ptr<uchar>(y);
+        switch (format) {
+        case OutputFormat::Rgba:
+            for (int x = 0; x < gray.cols; ++x) {
+                dst[x] = static_cast<uchar>(src[x] & 0xFFu);
+            }
+            break;
+        case OutputFormat::Gray8:
+            // Lowest byte is the leftmost pixel, so on little-endian hosts the row is plain bytes
+            memcpy(dst, src, gray.cols);
+            break;
+        case OutputFormat::Mask:
+            for (int x = 0; x < gray.cols; ++x) {
+                dst[x] = ((src[x >> 5] >> (x & 31)) & 1u) ? 255 : 0;
+            }
+            break;
+        }
+    }
 }
 
-void process_video_vulkan(const string& videoPath)
+void process_video_vulkan(const Options& opts)
 {
-    VideoCapture cap;
-    cap.open(videoPath);
+    if (opts.framesInFlight < 1) {
+        throw runtime_error("Error: --frames-in-flight must be at least 1.");
+    }
+    if (opts.streams < 1 || opts.queues < 1) {
+        throw runtime_error("Error: --streams and --queues must be at least 1.");
+    }
+    // Extra streams re-open the same source, e.g. to load one GPU with several copies of a file.
+    if ((opts.streams > 1 || opts.queues > 1) && (!opts.headless || opts.hybrid)) {
+        throw runtime_error("Error: --streams and --queues need --headless and no --hybrid.");
+    }
 
-    if (!cap.isOpened()) {
-        throw runtime_error("Error: Could not open video.");
+    vector<Stream> streams(opts.streams);
+    for (Stream& stream : streams) {
+        if (!source_open(&stream.source, opts.videoPath)) {
+            throw runtime_error("Error: Could not open video.");
+        }
     }
 
     Mat firstFrame;
-    cap >> firstFrame;
+    source_read(&streams[0].source, firstFrame);
     if (firstFrame.empty()) {
         throw runtime_error("Error: Video file is empty.");
     }
@@ -55,108 +200,409 @@ void process_video_vulkan(const string& videoPath)
     cout << "Video initialized. Input: " << width << "x" << height
          << " | Output: " << outWidth << "x" << outHeight << endl;
 
-    VulkanDisplay display(outWidth, outHeight);
-
-    // Use the same Vulkan objects for Kompute so compute output stays on the same GPU/device.
-    kp::Manager mgr(display.getInstance(), display.getPhysicalDevice(), display.getDevice());
-
-    vector<uint32_t> inInit(width * height, 0);
-    vector<uint32_t> outInit(outWidth * outHeight, 0);
-    vector<uint32_t> dims = { width, height };
-
-    auto tensorIn = mgr.tensorT<uint32_t>(inInit, kp::Memory::MemoryTypes::eDeviceAndHost);
-    auto tensorOut = mgr.tensorT<uint32_t>(outInit, kp::Memory::MemoryTypes::eDevice);
-    auto tensorDims = mgr.tensorT<uint32_t>(dims, kp::Memory::MemoryTypes::eDeviceAndHost);
-
-    auto memIn = static_pointer_cast<kp::Memory>(tensorIn);
-    auto memOut = static_pointer_cast<kp::Memory>(tensorOut);
-    auto memDims = static_pointer_cast<kp::Memory>(tensorDims);
-
-    vector<shared_ptr<kp::Memory>> params = {memIn, memOut, memDims};
+    VideoWriter writer;
+    if (!opts.outputPath.empty()) {
+        if (!opts.headless) {
+            throw runtime_error("Error: --output is only supported together with --headless.");
+        }
+        const double fps = source_get(&streams[0].source, CAP_PROP_FPS);
+        writer.open(opts.outputPath, VideoWriter::fourcc('m', 'p', '4', 'v'),
+                    fps > 0.0 ? fps : 30.0, Size(outWidth, outHeight), false);
+        if (!writer.isOpened()) {
+            throw runtime_error("Error: Could not open output video: " + opts.outputPath);
+        }
+    }
 
-    const vector<uint32_t> spirv = load_spirv("edge_detector.spv");
-    const kp::Workgroup workgroups = { (outWidth + 15) / 16, (outHeight + 15) / 16, 1 };
+    const InputFormat inputFormat = parse_input_format(opts.input);
+    const size_t inputBytes = input_bytes(inputFormat, width, height);
 
-    auto algorithm = mgr.algorithm(
-        params,
-        spirv,
-        workgroups,
-        vector<float>(),
-        vector<float>());
+    // Batching amortises one submit, sync and readback over several frames, which dominates
+    // at small resolutions. Frames of a batch sit back to back in the slot's tensors.
+    if (opts.batch < 1) {
+        throw runtime_error("Error: --batch must be at least 1.");
+    }
+    if (opts.batch > 1 && (!opts.headless || opts.shader == "graph")) {
+        throw runtime_error("Error: --batch needs --headless and the fused or tiled shader.");
+    }
+    const uint32_t batch = static_cast<uint32_t>(opts.batch);
 
-    vector<shared_ptr<kp::Memory>> dimParam = {memDims};
-    mgr.sequence()->record<kp::OpSyncDevice>(dimParam)->eval();
+    // The CPU rows run lab6's kernels straight off the BGR upload buffer, one frame at a time.
+    if (opts.hybrid && (!opts.headless || opts.shader == "graph" || inputFormat != InputFormat::Bgr ||
+                        batch > 1)) {
+        throw runtime_error("Error: --hybrid needs --headless, --input bgr, --batch 1 and the fused "
+                            "or tiled shader.");
+    }
 
-    auto seq = mgr.sequence();
-    vector<shared_ptr<kp::Memory>> inParam = {memIn};
-    seq->record<kp::OpSyncDevice>(inParam)
-       ->record<kp::OpAlgoDispatch>(algorithm);
+    // Compact output cuts readback and output memory; with a window it is expanded back to
+    // RGBA on the GPU just before the swapchain copy.
+    const OutputFormat outputFormat = parse_output_format(opts.outputFormat, opts.headless);
+
+    GpuEngineConfig config;
+    config.width = width;
+    config.height = height;
+    config.input = inputFormat;
+    config.output = outputFormat;
+    config.shader = opts.shader;
+    config.workgroup = opts.workgroup;
+    config.threshold = opts.threshold;
+    config.batch = batch;
+    config.framesInFlight = static_cast<uint32_t>(opts.framesInFlight);
+    config.streams = static_cast<uint32_t>(opts.streams);
+    config.queues = static_cast<uint32_t>(opts.queues);
+    config.queueFamily = static_cast<uint32_t>(opts.queueFamily);
+    // No swapchain to copy into when headless, so read the result back to host memory instead.
+    config.readback = opts.headless;
+    config.presentable = !opts.headless;
+
+    // Headless mode lets the engine create its own compute-only instance and device, so no
+    // window, surface or present-capable queue is needed (render nodes, lavapipe in CI).
+    const int64 deviceStart = getTickCount();
+    unique_ptr<VulkanDisplay> display;
+    unique_ptr<GpuEngine> engine;
+    if (opts.headless) {
+        engine = make_unique<GpuEngine>(config);
+    }
+    else {
+        display = make_unique<VulkanDisplay>(outWidth, outHeight,
+                                             static_cast<uint32_t>(opts.framesInFlight));
+        // Use the same Vulkan objects for Kompute so compute output stays on the same GPU/device.
+        engine = make_unique<GpuEngine>(
+            config, display->getInstance(), display->getPhysicalDevice(), display->getDevice());
+    }
+    const double pipelineMs = engine->pipelineMs();
+    const double deviceMs = ms_since(deviceStart) - pipelineMs;
+
+    cout << "Shader: " << opts.shader << " | Input: " << opts.input
+         << " (" << inputBytes << " bytes/frame) | Output: " << output_format_name(outputFormat)
+         << " (" << engine->outputFrameWords() * sizeof(uint32_t) << " bytes/frame)" << endl;
+    if (const PassGraph* graph = engine->graph()) {
+        cout << "Pass graph: " << graph->passCount() << " passes, "
+             << graph->barrierCount() << " barriers, "
+             << graph->allocatedTransients() << " of "
+             << graph->transientCount() << " transient buffers allocated per frame slot"
+             << endl;
+    }
 
-    auto outputBuffer = memOut->getPrimaryBuffer();
-    if (!outputBuffer) {
-        throw runtime_error("Failed to access output Vulkan buffer from Kompute tensor.");
+    for (uint32_t s = 0; s < streams.size(); ++s) {
+        for (size_t i = 0; i < engine->framesPerStream(); ++i) {
+            FrameSlot slot;
+            slot.gpu = &engine->frame(s, i);
+            streams[s].slots.push_back(move(slot));
+        }
     }
 
-    Mat frame = firstFrame;
-    Mat inputRGBA;
+    Mat decodeScratch;
+    Mat edges(outHeight, outWidth, CV_8UC1);
+
+    // Hybrid: start from an even split, moved in whole workgroup rows as timings come in.
+    unique_ptr<CpuEdgeWorkers> cpuWorkers;
+    unique_ptr<RowSplitter> splitter;
+    if (opts.hybrid) {
+        const unsigned cores = max(thread::hardware_concurrency(), 2u);
+        // Mask output thresholds the GPU rows, so the CPU rows get the same cutoff
+        cpuWorkers = make_unique<CpuEdgeWorkers>(
+            opts.cpuThreads > 0 ? static_cast<unsigned>(opts.cpuThreads) : cores - 1,
+            outputFormat == OutputFormat::Mask ? static_cast<int>(opts.threshold) : -1);
+        splitter = make_unique<RowSplitter>(outHeight, engine->workgroup().y, 0.5);
+        for (FrameSlot& slot : streams[0].slots) {
+            slot.cpuEdges.create(static_cast<int>(outHeight), static_cast<int>(outWidth), CV_8UC1);
+        }
+    }
 
-    cout << "Rendering with Vulkan swapchain. Close window or press Ctrl+C to exit." << endl;
+    if (opts.headless) {
+        cout << "Running headless compute. Press Ctrl+C to exit." << endl;
+    }
+    else {
+        cout << "Rendering with Vulkan swapchain. Close window or press Ctrl+C to exit." << endl;
+    }
+    cout << "Frames in flight: " << opts.framesInFlight;
+    if (batch > 1) {
+        cout << " | Frames per dispatch: " << batch;
+    }
+    if (streams.size() > 1 || opts.queues > 1) {
+        cout << " | Streams: " << streams.size() << " on " << opts.queues << " queue(s)";
+    }
+    cout << endl;
 
     const int64 streamStart = getTickCount();
     int totalFramesProcessed = 0;
-    const size_t inputBytes = static_cast<size_t>(width) * height * sizeof(uint32_t);
 
-    while (true) {
-        display.pollEvents();
-        if (display.shouldClose()) {
-            break;
+    StageHistogram decodeTime("decode (CPU)");
+    StageHistogram convertTime("convert to " + opts.input + " (CPU)");
+    const string perSubmit = batch > 1 ? " (GPU, per batch of " + to_string(batch) + ")" : " (GPU)";
+    // The input tensors are host-visible, so there is no upload copy to time; this is the sync op
+    StageHistogram inputSyncTime("input sync" + perSubmit);
+    StageHistogram dispatchTime("dispatch " + opts.shader + perSubmit);
+    StageHistogram readbackTime("readback" + perSubmit);
+    StageHistogram presentCopyTime("present copyBufferToImage (GPU)");
+    StageHistogram gpuRowsTime("hybrid GPU rows, submit to readback");
+    StageHistogram cpuRowsTime("hybrid CPU rows (" +
+                               to_string(cpuWorkers ? cpuWorkers->threadCount() : 0) + " threads)");
+
+    // Live metrics; the stage histograms mirror their samples into them
+    const char* stageHelp = "Time per frame (or batch) in each pipeline stage";
+    decodeTime.publish(metrics_latency("edge_stage_seconds", "stage=\"decode\"", stageHelp));
+    convertTime.publish(metrics_latency("edge_stage_seconds", "stage=\"convert\"", stageHelp));
+    inputSyncTime.publish(metrics_latency("edge_stage_seconds", "stage=\"input_sync\"", stageHelp));
+    dispatchTime.publish(metrics_latency("edge_stage_seconds", "stage=\"dispatch\"", stageHelp));
+    readbackTime.publish(metrics_latency("edge_stage_seconds", "stage=\"readback\"", stageHelp));
+    presentCopyTime.publish(metrics_latency("edge_stage_seconds", "stage=\"present_copy\"", stageHelp));
+    if (cpuWorkers) {
+        gpuRowsTime.publish(metrics_latency("edge_stage_seconds", "stage=\"hybrid_gpu_rows\"", stageHelp));
+        cpuRowsTime.publish(metrics_latency("edge_stage_seconds", "stage=\"hybrid_cpu_rows\"", stageHelp));
+    }
+    metricCounter_t* framesMetric = metrics_counter("edge_frames_total", "", "Frames processed");
+    metricGauge_t* fpsMetric = metrics_gauge("edge_fps", "", "Frames per second over the last second");
+    vector<metricGauge_t*> inFlightMetrics;
+    for (uint32_t s = 0; s < streams.size(); ++s) {
+        const string labels = "stream=\"" + to_string(s) + "\"";
+        inFlightMetrics.push_back(metrics_gauge("edge_gpu_frames_in_flight", labels.c_str(),
+                                                "Submissions queued on the GPU per stream"));
+    }
+    if (!opts.metricsAddress.empty()) {
+        if (metrics_serve(opts.metricsAddress.c_str()) != 0) {
+            throw runtime_error("Error: Could not serve metrics on " + opts.metricsAddress);
         }
-
-        if (frame.cols != static_cast<int>(width) || frame.rows != static_cast<int>(height)) {
-            throw runtime_error("Error: Frame resolution changed during processing.");
+        cout << "Serving metrics on " << opts.metricsAddress << endl;
+    }
+    int64 fpsWindowStart = streamStart;
+    int fpsWindowFrames = 0;
+
+    // Waits for stream s's oldest submitted frame, then presents it or reads it back.
+    auto finishOldest = [&](uint32_t s) {
+        GpuFrame& gpu = *engine->poll(s);
+        FrameSlot& slot = streams[s].slots[gpu.index];
+
+        double gpuSubmitMs = ms_since(slot.submitTicks); // upper bound; the host may poll late
+        if (gpu.timings.valid) {
+            inputSyncTime.add(gpu.timings.inputSyncMs);
+            dispatchTime.add(gpu.timings.dispatchMs);
+            if (opts.headless) {
+                readbackTime.add(gpu.timings.readbackMs);
+            }
+            gpuSubmitMs = gpu.timings.totalMs;
         }
-
-        cvtColor(frame, inputRGBA, COLOR_BGR2RGBA);
-        if (!inputRGBA.isContinuous()) {
-            inputRGBA = inputRGBA.clone();
+        if (slot.cpuStarted) {
+            // Both halves of the frame are done; steer the following frames toward equal times.
+            const double cpuMs = cpuWorkers->wait();
+            slot.cpuStarted = false;
+            gpuRowsTime.add(gpuSubmitMs);
+            cpuRowsTime.add(cpuMs);
+            splitter->update(gpu.rows, gpuSubmitMs, cpuMs);
         }
+        // Compute completed on-GPU, so the same GPU buffer is copied into the swapchain image.
+        if (display) {
+            slot.presentTicket = display->presentFromBuffer(*gpu.presentBuffer(), outWidth, outHeight);
+            for (double copyMs : display->takeCopyTimes()) {
+                presentCopyTime.add(copyMs);
+            }
+        }
+        else if (writer.isOpened() && s == 0 && cpuWorkers) {
+            unpack_output(gpu.output(0), outputFormat, slot.cpuEdges, static_cast<int>(gpu.rows));
+            writer.write(slot.cpuEdges);
+        }
+        else if (writer.isOpened() && s == 0) {
+            for (size_t f = 0; f < gpu.frames; ++f) {
+                unpack_output(gpu.output(f), outputFormat, edges, edges.rows);
+                writer.write(edges);
+            }
+        }
+        const bool firstResult = totalFramesProcessed == 0;
+        totalFramesProcessed += static_cast<int>(gpu.frames);
+
+        metrics_add(framesMetric, gpu.frames);
+        metrics_set(inFlightMetrics[s], static_cast<double>(engine->inFlight(s)));
+        fpsWindowFrames += static_cast<int>(gpu.frames);
+        const double windowMs = ms_since(fpsWindowStart);
+        if (windowMs >= 1000.0) {
+            metrics_set(fpsMetric, fpsWindowFrames * 1000.0 / windowMs);
+            fpsWindowStart = getTickCount();
+            fpsWindowFrames = 0;
+        }
+        if (firstResult) {
+            cout << "Startup: device " << deviceMs << " ms, pipelines + autotune " << pipelineMs
+                 << " ms, time to first frame " << ms_since(processStartTicks) << " ms" << endl;
+        }
+    };
+
+    // Decodes frames into slot from view `first` on until its batch is full or the stream
+    // ends. A short last batch is still dispatched whole; only its filled frames are used.
+    auto fill_slot = [&](Stream& stream, FrameSlot& slot, size_t first) {
+        GpuFrame& gpu = *slot.gpu;
+        gpu.frames = first;
+        while (gpu.frames < gpu.inputViews.size() &&
+               read_frame(stream.source, inputFormat, decodeScratch, gpu.inputViews[gpu.frames],
+                          decodeTime, convertTime)) {
+            gpu.frames++;
+        }
+        return gpu.frames > 0;
+    };
+
+    // The first frame was read to size the engine; every other stream starts from scratch.
+    store_frame(firstFrame, inputFormat, streams[0].slots[0].gpu->inputViews[0]);
+    fill_slot(streams[0], streams[0].slots[0], 1);
+    size_t activeStreams = streams.size();
+    for (size_t s = 1; s < streams.size(); ++s) {
+        if (!fill_slot(streams[s], streams[s].slots[0], 0)) {
+            streams[s].done = true;
+            activeStreams--;
+        }
+    }
 
-        memcpy(tensorIn->data(), inputRGBA.data, inputBytes);
-
-        // Compute completes on-GPU, then the same GPU buffer is copied into swapchain image.
-        seq->eval();
-        display.presentFromBuffer(*outputBuffer, outWidth, outHeight);
-
-        totalFramesProcessed++;
+    // Streams take turns submitting one frame (or batch) each.
+    bool windowClosed = false;
+    while (activeStreams > 0 && !windowClosed) {
+        for (uint32_t s = 0; s < streams.size() && !windowClosed; ++s) {
+            Stream& stream = streams[s];
+            if (stream.done) {
+                continue;
+            }
+            if (display) {
+                display->pollEvents();
+                if (display->shouldClose()) {
+                    windowClosed = true;
+                    break;
+                }
+            }
+
+            FrameSlot& slot = stream.slots[stream.frameIndex % stream.slots.size()];
+            stream.frameIndex++;
+
+            // The slot's previous output may still be queued for copying into the swapchain.
+            if (display) {
+                display->waitForPresent(slot.presentTicket);
+            }
+            slot.submitTicks = getTickCount();
+            engine->submit(*slot.gpu, splitter ? splitter->gpuRows() : GpuEngine::kAllRows);
+            metrics_set(inFlightMetrics[s], static_cast<double>(engine->inFlight(s)));
+
+            if (cpuWorkers) {
+                // The workers hold one frame at a time, so older frames (and their CPU rows) retire first.
+                while (engine->inFlight(s) > 1) {
+                    finishOldest(s);
+                }
+                cpuWorkers->start(slot.gpu->inputViews[0], slot.cpuEdges, static_cast<int>(slot.gpu->rows));
+                slot.cpuStarted = true;
+            }
+
+            // Present/read back older frames while this one computes.
+            while (engine->inFlight(s) >= stream.slots.size()) {
+                finishOldest(s);
+            }
+
+            // Decode the next frame(s) into the next slot, whose previous submission was just finished.
+            FrameSlot& nextSlot = stream.slots[stream.frameIndex % stream.slots.size()];
+            if (!fill_slot(stream, nextSlot, 0)) {
+                stream.done = true;
+                activeStreams--;
+            }
+        }
+    }
 
-        cap >> frame;
-        if (frame.empty()) {
-            break;
+    for (uint32_t s = 0; s < streams.size(); ++s) {
+        while (engine->inFlight(s) > 0) {
+            finishOldest(s);
         }
     }
 
     const double totalElapsed = (getTickCount() - streamStart) / getTickFrequency();
     if (totalElapsed > 0.0) {
         const double averageFps = totalFramesProcessed / totalElapsed;
+        cout << "Frames processed: " << totalFramesProcessed << endl;
         cout << "Average FPS: " << averageFps << endl;
     }
+    cout << "Upload size (" << opts.input << "): " << inputBytes << " bytes/frame" << endl;
+    if (!engine->timestampsSupported()) {
+        cout << "GPU timestamps not supported on this device; GPU stages not reported." << endl;
+    }
+    if (splitter) {
+        cout << "Hybrid split: GPU " << splitter->gpuRows() << " of " << outHeight << " rows ("
+             << splitter->gpuShare() * 100.0 << "%), CPU the rest on "
+             << cpuWorkers->threadCount() << " threads" << endl;
+    }
+    cout << "Per-stage timings:" << endl;
+    for (const StageHistogram* stage : { &decodeTime, &convertTime, &inputSyncTime, &dispatchTime,
+                                         &readbackTime, &presentCopyTime, &gpuRowsTime,
+                                         &cpuRowsTime }) {
+        stage->print(cout);
+    }
 
-    cap.release();
+    writer.release();
+    for (Stream& stream : streams) {
+        source_release(&stream.source);
+    }
 }
 
 int main(int argc, char** argv)
 {
-    string videoPath = "0";
-    if (argc == 2) {
-        videoPath = argv[1];
-    }
-    else if (argc > 2) {
-        cerr << "Incorrect usage - use: edge_detector_final [video_path]" << endl;
-        return EXIT_FAILURE;
+    const string usage =
+        "Incorrect usage - use: edge_detector_final [video_path|synth:WxH[@fps][:pattern[:frames]]] [--headless] [--output out.mp4]"
+        " [--shader fused|tiled|graph] [--threshold 0-255] [--input rgba|bgr|gray] [--frames-in-flight N]"
+        " [--workgroup auto|WxH] [--batch K] [--hybrid] [--cpu-threads N]"
+        " [--output-format auto|rgba|gray8|mask] [--streams N] [--queues N] [--queue-family F]"
+        " [--metrics [host:]port|unix:path]";
+
+    Options opts;
+    bool haveVideoPath = false;
+    for (int i = 1; i < argc; ++i) {
+        const string arg = argv[i];
+        if (arg == "--headless") {
+            opts.headless = true;
+        }
+        else if (arg == "--output" && i + 1 < argc) {
+            opts.outputPath = argv[++i];
+        }
+        else if (arg == "--shader" && i + 1 < argc) {
+            opts.shader = argv[++i];
+        }
+        else if (arg == "--input" && i + 1 < argc) {
+            opts.input = argv[++i];
+        }
+        else if (arg == "--frames-in-flight" && i + 1 < argc) {
+            opts.framesInFlight = atoi(argv[++i]);
+        }
+        else if (arg == "--threshold" && i + 1 < argc) {
+            opts.threshold = static_cast<uint32_t>(atoi(argv[++i]));
+        }
+        else if (arg == "--batch" && i + 1 < argc) {
+            opts.batch = atoi(argv[++i]);
+        }
+        else if (arg == "--output-format" && i + 1 < argc) {
+            opts.outputFormat = argv[++i];
+        }
+        else if (arg == "--streams" && i + 1 < argc) {
+            opts.streams = atoi(argv[++i]);
+        }
+        else if (arg == "--queues" && i + 1 < argc) {
+            opts.queues = atoi(argv[++i]);
+        }
+        else if (arg == "--queue-family" && i + 1 < argc) {
+            opts.queueFamily = atoi(argv[++i]);
+        }
+        else if (arg == "--hybrid") {
+            opts.hybrid = true;
+        }
+        else if (arg == "--cpu-threads" && i + 1 < argc) {
+            opts.cpuThreads = atoi(argv[++i]);
+        }
+        else if (arg == "--workgroup" && i + 1 < argc) {
+            opts.workgroup = argv[++i];
+        }
+        else if (arg == "--metrics" && i + 1 < argc) {
+            opts.metricsAddress = argv[++i];
+        }
+        else if (arg.rfind("--", 0) != 0 && !haveVideoPath) {
+            opts.videoPath = arg;
+            haveVideoPath = true;
+        }
+        else {
+            cerr << usage << endl;
+            return EXIT_FAILURE;
+        }
     }
 
     try {
-        process_video_vulkan(videoPath);
+        process_video_vulkan(opts);
     }
     catch (const exception& e) {
         cerr << "Error: " << e.what() << endl;
@@ -0,0 +1,71 @@
+#include "embedded_shaders.hpp"
+
+#include <stdexcept>
+
+using namespace std;
+
+namespace {
+
+const uint32_t kEdgeDetector[] = {
+#include "edge_detector.spv.inc"
+};
+
+const uint32_t kEdgeDetectorTiled[] = {
+#include "edge_detector_tiled.spv.inc"
+};
+
+const uint32_t kGrayscale[] = {
+#include "grayscale.spv.inc"
+};
+
+const uint32_t kBlur[] = {
+#include "blur.spv.inc"
+};
+
+const uint32_t kSobel[] = {
+#include "sobel.spv.inc"
+};
+
+const uint32_t kNms[] = {
+#include "nms.spv.inc"
+};
+
+const uint32_t kThreshold[] = {
+#include "threshold.spv.inc"
+};
+
+const uint32_t kExpand[] = {
+#include "expand.spv.inc"
+};
+
+struct EmbeddedShader
+{
+    const char* name;
+    const uint32_t* words;
+    size_t count;
+};
+
+#define EMBEDDED(name, array) { name, array, sizeof(array) / sizeof(array[0]) }
+
+const EmbeddedShader kShaders[] = {
+    EMBEDDED("edge_detector", kEdgeDetector),
+    EMBEDDED("edge_detector_tiled", kEdgeDetectorTiled),
+    EMBEDDED("grayscale", kGrayscale),
+    EMBEDDED("blur", kBlur),
+    EMBEDDED("sobel", kSobel),
+    EMBEDDED("nms", kNms),
+    EMBEDDED("threshold", kThreshold),
+    EMBEDDED("expand", kExpand),
+};
+
+} // namespace
+
+vector<uint32_t> embedded_spirv(const string& name)
+{
+    for (const EmbeddedShader& shader : kShaders) {
+        if (name == shader.name) {
+            return vector<uint32_t>(shader.words, shader.words + shader.count);
+        }
+    }
+    throw runtime_error("No embedded SPIR-V named: " + name);
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// SPIR-V compiled at build time (glslc -mfmt=num) and linked into the binary, so the
+// executable no longer depends on .spv files in the current working directory.
+// name is the shader's base file name, e.g. "edge_detector" for edge_detector.comp.
+std::vector<uint32_t> embedded_spirv(const std::string& name);
@@ -0,0 +1,577 @@
+#include "gpu_engine.hpp"
+
+#include "embedded_shaders.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+using namespace cv;
+using namespace std;
+
+InputFormat parse_input_format(const string& name)
+{
+    if (name == "rgba") {
+        return InputFormat::Rgba;
+    }
+    if (name == "bgr") {
+        return InputFormat::Bgr;
+    }
+    if (name == "gray") {
+        return InputFormat::Gray;
+    }
+    throw runtime_error("Error: --input must be \"rgba\", \"bgr\" or \"gray\".");
+}
+
+size_t input_bytes(InputFormat format, uint32_t width, uint32_t height)
+{
+    const size_t pixels = static_cast<size_t>(width) * height;
+    switch (format) {
+    case InputFormat::Rgba:
+        return pixels * 4;
+    case InputFormat::Bgr:
+        return pixels * 3;
+    case InputFormat::Gray:
+        return pixels;
+    }
+    return 0;
+}
+
+OutputFormat parse_output_format(const string& name, bool headless)
+{
+    if (name == "auto") {
+        return headless ? OutputFormat::Gray8 : OutputFormat::Rgba;
+    }
+    if (name == "rgba") {
+        return OutputFormat::Rgba;
+    }
+    if (name == "gray8") {
+        return OutputFormat::Gray8;
+    }
+    if (name == "mask") {
+        return OutputFormat::Mask;
+    }
+    throw runtime_error("Error: --output-format must be \"auto\", \"rgba\", \"gray8\" or \"mask\".");
+}
+
+const char* output_format_name(OutputFormat format)
+{
+    switch (format) {
+    case OutputFormat::Rgba:
+        return "rgba";
+    case OutputFormat::Gray8:
+        return "gray8";
+    case OutputFormat::Mask:
+        return "mask";
+    }
+    return "";
+}
+
+uint32_t output_row_words(OutputFormat format, uint32_t outWidth)
+{
+    switch (format) {
+    case OutputFormat::Rgba:
+        return outWidth;
+    case OutputFormat::Gray8:
+        return (outWidth + 3) / 4;
+    case OutputFormat::Mask:
+        return (outWidth + 31) / 32;
+    }
+    return 0;
+}
+
+uint32_t input_frame_words(InputFormat format, uint32_t width, uint32_t height)
+{
+    return static_cast<uint32_t>((input_bytes(format, width, height) + sizeof(uint32_t) - 1) /
+                                 sizeof(uint32_t));
+}
+
+namespace {
+
+using Tensor = shared_ptr<kp::TensorT<uint32_t>>;
+
+double ms_since(int64 startTicks)
+{
+    return (getTickCount() - startTicks) * 1000.0 / getTickFrequency();
+}
+
+// Kompute's Manager(0, families) takes queues from the given family of physical device 0
+// without checking it, so a graphics- or transfer-only family would only fail later in an
+// unrelated Vulkan call. Look at the family first with a short-lived instance of our own.
+void check_queue_family(uint32_t family, uint32_t queues)
+{
+    const vk::ApplicationInfo appInfo("edge_detector_final", 1, "cpe442", 1, VK_API_VERSION_1_0);
+    const vk::UniqueInstance instance =
+        vk::createInstanceUnique(vk::InstanceCreateInfo(vk::InstanceCreateFlags(), &appInfo));
+    const vector<vk::PhysicalDevice> devices = instance->enumeratePhysicalDevices();
+    if (devices.empty()) {
+        throw runtime_error("Error: No Vulkan device found.");
+    }
+    const vector<vk::QueueFamilyProperties> families = devices[0].getQueueFamilyProperties();
+    if (family >= families.size()) {
+        throw runtime_error("Error: --queue-family " + to_string(family) + " does not exist, the device has " +
+                            to_string(families.size()) + " queue families.");
+    }
+    if (!(families[family].queueFlags & vk::QueueFlagBits::eCompute)) {
+        throw runtime_error("Error: --queue-family " + to_string(family) + " has no compute support (" +
+                            vk::to_string(families[family].queueFlags) + "); pick a family with Compute.");
+    }
+    if (queues > families[family].queueCount) {
+        throw runtime_error("Error: --queues " + to_string(queues) + " is more than the " +
+                            to_string(families[family].queueCount) + " queues of family " +
+                            to_string(family) + ".");
+    }
+}
+
+const vector<WorkgroupShape> kAutotuneShapes = { {8, 8}, {16, 16}, {32, 8} };
+const int kAutotuneRuns = 10;
+
+vector<WorkgroupShape> parse_workgroup(const string& spec)
+{
+    if (spec == "auto") {
+        return kAutotuneShapes;
+    }
+    unsigned x = 0;
+    unsigned y = 0;
+    char extra = 0;
+    if (sscanf(spec.c_str(), "%ux%u%c", &x, &y, &extra) != 2 || x == 0 || y == 0) {
+        throw runtime_error("Error: --workgroup must be \"auto\" or WxH, e.g. 16x16.");
+    }
+    return { {x, y} };
+}
+
+// A shape given with --workgroup skips autotuning, so check it here rather than have the
+// pipeline fail to build. The tiled shader also stages a (W*pixels per word+2) x (H+2) apron
+// of floats in shared memory.
+void check_workgroup(const WorkgroupShape& shape, const vk::PhysicalDeviceLimits& limits,
+                     bool tiled, uint32_t pixelsPerWord)
+{
+    if (shape.x > limits.maxComputeWorkGroupSize[0] || shape.y > limits.maxComputeWorkGroupSize[1]) {
+        throw runtime_error("Error: --workgroup " + to_string(shape.x) + "x" + to_string(shape.y) +
+                            " exceeds this device's maximum of " +
+                            to_string(limits.maxComputeWorkGroupSize[0]) + "x" +
+                            to_string(limits.maxComputeWorkGroupSize[1]) + ".");
+    }
+    if (static_cast<uint64_t>(shape.x) * shape.y > limits.maxComputeWorkGroupInvocations) {
+        throw runtime_error("Error: --workgroup " + to_string(shape.x) + "x" + to_string(shape.y) +
+                            " exceeds this device's " +
+                            to_string(limits.maxComputeWorkGroupInvocations) + " invocations per workgroup.");
+    }
+    const uint64_t tileBytes = (static_cast<uint64_t>(shape.x) * pixelsPerWord + 2) * (shape.y + 2) * sizeof(float);
+    if (tiled && tileBytes > limits.maxComputeSharedMemorySize) {
+        throw runtime_error("Error: --workgroup " + to_string(shape.x) + "x" + to_string(shape.y) +
+                            " needs a " + to_string(tileBytes) + "-byte tile in the tiled shader, but this device has " +
+                            to_string(limits.maxComputeSharedMemorySize) + " bytes of shared memory.");
+    }
+}
+
+// Fused/tiled edge detector over in -> out, one z slice per batched frame
+shared_ptr<kp::Algorithm> make_algorithm(kp::Manager& mgr, const Tensor& in, const Tensor& out,
+                                         uint32_t frames,
+                                         const vector<uint32_t>& spirv, InputFormat format,
+                                         OutputFormat outputFormat, uint32_t threshold,
+                                         WorkgroupShape shape, uint32_t width, uint32_t height)
+{
+    const uint32_t outWidth = width - 2;
+    const uint32_t outHeight = height - 2;
+    vector<shared_ptr<kp::Memory>> params = {
+        static_pointer_cast<kp::Memory>(in),
+        static_pointer_cast<kp::Memory>(out)};
+    // One invocation per output word, and one z slice per frame in the batch
+    const uint32_t rowWords = output_row_words(outputFormat, outWidth);
+    const kp::Workgroup workgroups = {
+        (rowWords + shape.x - 1) / shape.x, (outHeight + shape.y - 1) / shape.y,
+        frames};
+
+    // Input dims go in as push constants instead of a storage buffer read by every invocation.
+    return mgr.algorithm<uint32_t, uint32_t>(
+        params,
+        spirv,
+        workgroups,
+        { static_cast<uint32_t>(format), shape.x, shape.y,
+          static_cast<uint32_t>(outputFormat), threshold },
+        { width, height, input_frame_words(format, width, height) });
+}
+
+// Times a few dispatches of each candidate shape over the frame already in `in` and
+// returns the fastest. Uses GPU timestamps when available, wall time otherwise.
+WorkgroupShape autotune_workgroup(kp::Manager& mgr, const Tensor& in, const Tensor& out,
+                                  uint32_t frames,
+                                  const vector<uint32_t>& spirv, InputFormat format,
+                                  OutputFormat outputFormat, uint32_t threshold,
+                                  uint32_t width, uint32_t height,
+                                  const vector<WorkgroupShape>& candidates,
+                                  bool useTimestamps, double timestampPeriodNs)
+{
+    if (candidates.size() == 1) {
+        return candidates.front();
+    }
+
+    vector<shared_ptr<kp::Memory>> inParam = {static_pointer_cast<kp::Memory>(in)};
+    mgr.sequence()->record<kp::OpSyncDevice>(inParam)->eval();
+
+    WorkgroupShape best = candidates.front();
+    double bestMs = 0.0;
+    for (const WorkgroupShape& shape : candidates) {
+        auto algorithm = make_algorithm(mgr, in, out, frames, spirv, format, outputFormat, threshold,
+                                        shape, width, height);
+        auto seq = mgr.sequence(0, useTimestamps ? 2 : 0);
+        seq->record<kp::OpAlgoDispatch>(algorithm);
+        seq->eval(); // warm-up
+
+        double totalMs = 0.0;
+        for (int run = 0; run < kAutotuneRuns; ++run) {
+            const int64 start = getTickCount();
+            seq->eval();
+            if (useTimestamps) {
+                const vector<uint64_t> timestamps = seq->getTimestamps();
+                totalMs += (timestamps.at(1) - timestamps.at(0)) * timestampPeriodNs / 1e6;
+            }
+            else {
+                totalMs += ms_since(start);
+            }
+        }
+        const double averageMs = totalMs / kAutotuneRuns;
+        cout << "Autotune workgroup " << shape.x << "x" << shape.y << ": " << averageMs << " ms" << endl;
+
+        if (&shape == &candidates.front() || averageMs < bestMs) {
+            best = shape;
+            bestMs = averageMs;
+        }
+    }
+    return best;
+}
+
+// grayscale -> blur -> Sobel -> NMS -> threshold, recorded into one sequence. Writes the same
+// output layouts as edge_detector.comp, so presenting and readback are unchanged.
+unique_ptr<PassGraph> build_edge_graph(kp::Manager& mgr, const Tensor& in, const Tensor& out,
+                                       InputFormat format, OutputFormat outputFormat,
+                                       WorkgroupShape shape, uint32_t width, uint32_t height,
+                                       uint32_t threshold)
+{
+    auto graph = make_unique<PassGraph>(mgr);
+    const uint32_t pixels = width * height;
+
+    const auto input = graph->importBuffer(static_pointer_cast<kp::Memory>(in));
+    const auto output = graph->importBuffer(static_pointer_cast<kp::Memory>(out));
+    const auto gray = graph->createTransient("gray", pixels);
+    const auto blurred = graph->createTransient("blurred", pixels);
+    const auto magnitude = graph->createTransient("magnitude", pixels);
+    const auto thinned = graph->createTransient("nms", pixels);
+
+    const kp::Workgroup full = {
+        (width + shape.x - 1) / shape.x, (height + shape.y - 1) / shape.y, 1};
+    const uint32_t rowWords = output_row_words(outputFormat, width - 2);
+    const kp::Workgroup cropped = {
+        (rowWords + shape.x - 1) / shape.x, (height - 2 + shape.y - 1) / shape.y, 1};
+    const vector<uint32_t> dims = { width, height };
+
+    graph->addPass("grayscale", embedded_spirv("grayscale"), {input}, {gray}, full,
+                   { static_cast<uint32_t>(format), shape.x, shape.y }, dims);
+    graph->addPass("blur", embedded_spirv("blur"), {gray}, {blurred}, full,
+                   { 0, shape.x, shape.y }, dims);
+    graph->addPass("sobel", embedded_spirv("sobel"), {blurred}, {magnitude}, full,
+                   { 0, shape.x, shape.y }, dims);
+    graph->addPass("nms", embedded_spirv("nms"), {magnitude, blurred}, {thinned}, full,
+                   { 0, shape.x, shape.y }, dims);
+    graph->addPass("threshold", embedded_spirv("threshold"), {thinned}, {output}, cropped,
+                   { threshold, shape.x, shape.y, static_cast<uint32_t>(outputFormat) }, dims);
+    graph->compile();
+    return graph;
+}
+
+} // namespace
+
+const uint32_t* GpuFrame::output(size_t f) const
+{
+    return tensorOut->data() + f * outputFrameWords;
+}
+
+const shared_ptr<vk::Buffer>& GpuFrame::presentBuffer() const
+{
+    return outputBuffer;
+}
+
+GpuEngine::GpuEngine(const GpuEngineConfig& config)
+    : mConfig(config)
+{
+    const int64 deviceStart = getTickCount();
+    if (config.queues > 1) {
+        check_queue_family(config.queueFamily, config.queues);
+        // One queue per entry; Kompute numbers repeated entries of a family 0, 1, ...
+        mMgr = make_unique<kp::Manager>(0, vector<uint32_t>(config.queues, config.queueFamily));
+    }
+    else {
+        mMgr = make_unique<kp::Manager>();
+    }
+    mDeviceMs = ms_since(deviceStart);
+    build();
+}
+
+GpuEngine::GpuEngine(const GpuEngineConfig& config,
+                     shared_ptr<vk::Instance> instance,
+                     shared_ptr<vk::PhysicalDevice> physicalDevice,
+                     shared_ptr<vk::Device> device)
+    : mConfig(config)
+{
+    if (config.queues > 1) {
+        throw runtime_error("GpuEngine: a caller-provided device only gets one compute queue.");
+    }
+    const int64 deviceStart = getTickCount();
+    mMgr = make_unique<kp::Manager>(instance, physicalDevice, device);
+    mDeviceMs = ms_since(deviceStart);
+    build();
+}
+
+void GpuEngine::build()
+{
+    const GpuEngineConfig& c = mConfig;
+    if (c.width < 3 || c.height < 3) {
+        throw runtime_error("Error: Input frame must be at least 3x3 for Sobel.");
+    }
+    if (c.shader != "fused" && c.shader != "tiled" && c.shader != "graph") {
+        throw runtime_error("Error: --shader must be \"fused\", \"tiled\" or \"graph\".");
+    }
+    if (c.batch < 1 || c.framesInFlight < 1 || c.streams < 1 || c.queues < 1) {
+        throw runtime_error("GpuEngine: batch, framesInFlight, streams and queues must be at least 1.");
+    }
+    if (c.batch > 1 && c.shader == "graph") {
+        throw runtime_error("Error: --batch needs the fused or tiled shader.");
+    }
+    if (c.output == OutputFormat::Mask && c.shader == "tiled") {
+        throw runtime_error("Error: --output-format mask needs the fused or graph shader.");
+    }
+    if (c.output == OutputFormat::Mask && c.threshold == 0) {
+        throw runtime_error("Error: --output-format mask needs a --threshold above 0.");
+    }
+
+    const bool useGraph = c.shader == "graph";
+    const uint32_t outWidth = c.width - 2;
+    const uint32_t outHeight = c.height - 2;
+    const uint32_t inputFrameWords = input_frame_words(c.input, c.width, c.height);
+    mOutputFrameWords = static_cast<size_t>(output_row_words(c.output, outWidth)) * outHeight;
+
+    const vector<uint32_t> spirv = useGraph ? vector<uint32_t>() : embedded_spirv(
+        c.shader == "tiled" ? "edge_detector_tiled" : "edge_detector");
+    // Compact output is expanded back to RGBA on the GPU only when it is going to be presented.
+    const bool expandOutput = c.presentable && c.output != OutputFormat::Rgba;
+    const vector<uint32_t> expandSpirv = expandOutput ? embedded_spirv("expand") : vector<uint32_t>();
+    const vector<WorkgroupShape> workgroupCandidates = parse_workgroup(c.workgroup);
+
+    // GPU timestamps are written at the start of the sequence and after each recorded op,
+    // so [1 + dispatchOps] - [1] brackets the dispatch (or the whole pass graph) alone.
+    const vk::PhysicalDeviceProperties deviceProps = mMgr->getDeviceProperties();
+    mTimestamps = deviceProps.limits.timestampComputeAndGraphics;
+    mTimestampPeriodNs = deviceProps.limits.timestampPeriod;
+    if (c.workgroup != "auto") {
+        check_workgroup(workgroupCandidates.front(), deviceProps.limits, c.shader == "tiled",
+                        c.output == OutputFormat::Gray8 ? 4 : 1);
+    }
+
+    vector<uint32_t> inInit(static_cast<size_t>(inputFrameWords) * c.batch, 0);
+    vector<uint32_t> outInit(mOutputFrameWords * c.batch, 0);
+    const int viewType = c.input == InputFormat::Rgba ? CV_8UC4 :
+                         c.input == InputFormat::Bgr ? CV_8UC3 : CV_8UC1;
+
+    // One input/output tensor pair and sequence per frame in flight, so the next frame can be
+    // decoded and uploaded while earlier ones are still computing or being presented.
+    const int64 pipelineStart = getTickCount();
+    mFrames.resize(c.streams);
+    mPending.resize(c.streams);
+    for (uint32_t s = 0; s < c.streams; ++s) {
+        mFrames[s].resize(c.framesInFlight);
+        for (size_t i = 0; i < mFrames[s].size(); ++i) {
+            GpuFrame& frame = mFrames[s][i];
+            frame.stream = s;
+            frame.index = i;
+            frame.rows = outHeight;
+            frame.outputFrameWords = mOutputFrameWords;
+            frame.tensorIn = mMgr->tensorT<uint32_t>(inInit, kp::Memory::MemoryTypes::eDeviceAndHost);
+            frame.tensorOut = mMgr->tensorT<uint32_t>(outInit, kp::Memory::MemoryTypes::eDevice);
+            for (uint32_t f = 0; f < c.batch; ++f) {
+                frame.inputViews.emplace_back(static_cast<int>(c.height), static_cast<int>(c.width),
+                                              viewType,
+                                              frame.tensorIn->data() + static_cast<size_t>(f) * inputFrameWords);
+            }
+        }
+    }
+
+    // Autotuning times a single dispatch, so the graph uses 16x16 unless a shape is given. The
+    // Sobel shaders do the same work whatever the pixel values, so the zeroed input will do.
+    const GpuFrame& first = mFrames[0][0];
+    mWorkgroup = useGraph
+        ? (workgroupCandidates.size() == 1 ? workgroupCandidates.front() : WorkgroupShape{16, 16})
+        : autotune_workgroup(*mMgr, first.tensorIn, first.tensorOut, c.batch, spirv, c.input,
+                             c.output, c.threshold, c.width, c.height,
+                             workgroupCandidates, mTimestamps, mTimestampPeriodNs);
+    cout << "Workgroup: " << mWorkgroup.x << "x" << mWorkgroup.y << endl;
+
+    for (uint32_t s = 0; s < c.streams; ++s) {
+        for (GpuFrame& frame : mFrames[s]) {
+            if (useGraph) {
+                frame.graph = build_edge_graph(*mMgr, frame.tensorIn, frame.tensorOut, c.input, c.output,
+                                               mWorkgroup, c.width, c.height, c.threshold);
+                mDispatchOps = frame.graph->recordedOps();
+            }
+            else {
+                frame.algorithm = make_algorithm(*mMgr, frame.tensorIn, frame.tensorOut, c.batch, spirv,
+                                                 c.input, c.output, c.threshold, mWorkgroup,
+                                                 c.width, c.height);
+                mDispatchOps = 1;
+            }
+            if (expandOutput) {
+                vector<uint32_t> displayInit(static_cast<size_t>(outWidth) * outHeight, 0);
+                frame.tensorDisplay = mMgr->tensorT<uint32_t>(displayInit, kp::Memory::MemoryTypes::eDevice);
+                frame.expand = mMgr->algorithm<uint32_t, uint32_t>(
+                    { static_pointer_cast<kp::Memory>(frame.tensorOut),
+                      static_pointer_cast<kp::Memory>(frame.tensorDisplay) },
+                    expandSpirv,
+                    { (outWidth + mWorkgroup.x - 1) / mWorkgroup.x,
+                      (outHeight + mWorkgroup.y - 1) / mWorkgroup.y, 1 },
+                    { static_cast<uint32_t>(c.output), mWorkgroup.x, mWorkgroup.y },
+                    { outWidth, outHeight });
+                mDispatchOps += 2; // barrier + expansion, timed as part of the dispatch stage
+            }
+
+            // Kompute writes one timestamp per recorded op, so the pool must match the op count.
+            const uint32_t recordedOps = 1 + mDispatchOps + (c.readback ? 1 : 0);
+            frame.seq = mMgr->sequence(s % c.queues, mTimestamps ? recordedOps + 1 : 0);
+            record(frame);
+
+            frame.outputBuffer =
+                (frame.tensorDisplay ? frame.tensorDisplay : frame.tensorOut)->getPrimaryBuffer();
+            if (!frame.outputBuffer) {
+                throw runtime_error("Failed to access output Vulkan buffer from Kompute tensor.");
+            }
+        }
+    }
+    mPipelineMs = ms_since(pipelineStart);
+}
+
+void GpuEngine::record(GpuFrame& frame)
+{
+    vector<shared_ptr<kp::Memory>> inParam = {static_pointer_cast<kp::Memory>(frame.tensorIn)};
+    vector<shared_ptr<kp::Memory>> outParam = {static_pointer_cast<kp::Memory>(frame.tensorOut)};
+    frame.seq->record<kp::OpSyncDevice>(inParam);
+    if (frame.graph) {
+        frame.graph->record(frame.seq);
+    }
+    else {
+        frame.seq->record<kp::OpAlgoDispatch>(frame.algorithm);
+    }
+    if (frame.expand) {
+        frame.seq->record<kp::OpMemoryBarrier>(
+            outParam,
+            vk::AccessFlagBits::eShaderWrite,
+            vk::AccessFlagBits::eShaderRead,
+            vk::PipelineStageFlagBits::eComputeShader,
+            vk::PipelineStageFlagBits::eComputeShader);
+        frame.seq->record<kp::OpAlgoDispatch>(frame.expand);
+    }
+    if (mConfig.readback) {
+        frame.seq->record<kp::OpSyncLocal>(outParam);
+    }
+}
+
+size_t GpuEngine::framesPerStream() const
+{
+    return mConfig.framesInFlight;
+}
+
+GpuFrame& GpuEngine::frame(uint32_t stream, size_t index)
+{
+    return mFrames.at(stream).at(index);
+}
+
+void GpuEngine::submit(GpuFrame& frame, uint32_t rows)
+{
+    if (frame.inFlight) {
+        throw runtime_error("GpuEngine: frame submitted again before poll() returned it.");
+    }
+    rows = clamp(rows, 1u, mConfig.height - 2);
+    if (rows != frame.rows) {
+        if (!frame.algorithm || mConfig.batch > 1) {
+            throw runtime_error("GpuEngine: partial frames need the fused or tiled shader and batch 1.");
+        }
+        // Shrink or grow the grid to the requested rows; the rest are never dispatched.
+        frame.rows = rows;
+        kp::Workgroup grid = frame.algorithm->getWorkgroup();
+        grid[1] = (rows + mWorkgroup.y - 1) / mWorkgroup.y;
+        frame.algorithm->setWorkgroup(grid);
+        frame.seq->clear();
+        record(frame);
+    }
+    frame.seq->evalAsync();
+    frame.inFlight = true;
+    mPending[frame.stream].push_back(&frame);
+}
+
+GpuFrame* GpuEngine::poll(uint32_t stream)
+{
+    deque<GpuFrame*>& pending = mPending.at(stream);
+    if (pending.empty()) {
+        return nullptr;
+    }
+    GpuFrame& frame = *pending.front();
+    pending.pop_front();
+
+    frame.seq->evalAwait();
+    frame.inFlight = false;
+    frame.timings = GpuTimings();
+    if (mTimestamps) {
+        // [0] start, [1] after the input sync, [1 + dispatchOps] after compute, then readback
+        const vector<uint64_t> timestamps = frame.seq->getTimestamps();
+        auto gpuMs = [&](size_t from, size_t to) {
+            return (timestamps.at(to) - timestamps.at(from)) * mTimestampPeriodNs / 1e6;
+        };
+        frame.timings.valid = true;
+        frame.timings.inputSyncMs = gpuMs(0, 1);
+        frame.timings.dispatchMs = gpuMs(1, 1 + mDispatchOps);
+        if (mConfig.readback) {
+            frame.timings.readbackMs = gpuMs(1 + mDispatchOps, 2 + mDispatchOps);
+        }
+        frame.timings.totalMs = gpuMs(0, timestamps.size() - 1);
+    }
+    return &frame;
+}
+
+size_t GpuEngine::inFlight(uint32_t stream) const
+{
+    return mPending.at(stream).size();
+}
+
+const GpuEngineConfig& GpuEngine::config() const
+{
+    return mConfig;
+}
+
+WorkgroupShape GpuEngine::workgroup() const
+{
+    return mWorkgroup;
+}
+
+bool GpuEngine::timestampsSupported() const
+{
+    return mTimestamps;
+}
+
+size_t GpuEngine::outputFrameWords() const
+{
+    return mOutputFrameWords;
+}
+
+const PassGraph* GpuEngine::graph() const
+{
+    return mFrames.empty() || mFrames[0].empty() ? nullptr : mFrames[0][0].graph.get();
+}
+
+double GpuEngine::deviceMs() const
+{
+    return mDeviceMs;
+}
+
+double GpuEngine::pipelineMs() const
+{
+    return mPipelineMs;
+}
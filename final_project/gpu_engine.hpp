@@ -0,0 +1,178 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+#include <kompute/Kompute.hpp>
+
+#include "pass_graph.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Matches INPUT_RGBA/INPUT_BGR/INPUT_GRAY (specialization constant 0) in the shaders
+enum class InputFormat : uint32_t
+{
+    Rgba = 0,
+    Bgr = 1,
+    Gray = 2
+};
+
+InputFormat parse_input_format(const std::string& name);
+size_t input_bytes(InputFormat format, uint32_t width, uint32_t height);
+
+// Words between consecutive frames of a batch in an input tensor
+uint32_t input_frame_words(InputFormat format, uint32_t width, uint32_t height);
+
+// Matches OUTPUT_RGBA/OUTPUT_GRAY8/OUTPUT_MASK (specialization constant 3) in the shaders
+enum class OutputFormat : uint32_t
+{
+    Rgba = 0,
+    Gray8 = 1,
+    Mask = 2
+};
+
+OutputFormat parse_output_format(const std::string& name, bool headless);
+const char* output_format_name(OutputFormat format);
+
+// Output rows are padded to whole words, so a row starts at y * output_row_words()
+uint32_t output_row_words(OutputFormat format, uint32_t outWidth);
+
+// Workgroup shape, passed to the shaders as specialization constants 1 and 2
+struct WorkgroupShape
+{
+    uint32_t x;
+    uint32_t y;
+};
+
+struct GpuEngineConfig
+{
+    uint32_t width = 0;  // input frame size; the output is (width-2)x(height-2)
+    uint32_t height = 0;
+    InputFormat input = InputFormat::Bgr;
+    OutputFormat output = OutputFormat::Rgba;
+    std::string shader = "fused";   // "fused", "tiled" or "graph"
+    std::string workgroup = "auto"; // "WxH", or "auto" to time the candidate shapes
+    uint32_t threshold = 40;        // graph and mask output: 0-255 edge cutoff
+    uint32_t batch = 1;             // fused/tiled: frames per submission, one per z slice
+    uint32_t framesInFlight = 2;    // frames per stream, each with its own tensors and sequence
+    uint32_t streams = 1;           // independent frame sequences sharing the device
+    uint32_t queues = 1;            // own device: compute queues the streams are spread over
+    uint32_t queueFamily = 0;       // own device with queues > 1: family the queues come from
+    bool readback = true;           // copy the output to host memory after every submission
+    bool presentable = false;       // keep an RGBA copy of compact output for copyBufferToImage
+};
+
+// GPU times of one submission, from device timestamps
+struct GpuTimings
+{
+    bool valid = false; // false when the device has no compute timestamps
+    // OpSyncDevice on the input; the tensors are host-visible, so this is barrier and
+    // submission overhead rather than a copy
+    double inputSyncMs = 0.0;
+    double dispatchMs = 0.0;
+    double readbackMs = 0.0;
+    double totalMs = 0.0;
+};
+
+// One frame in flight: input/output tensors and the sequence that processes them
+struct GpuFrame
+{
+    // Set by the caller before submit()
+    std::vector<cv::Mat> inputViews; // one header per batched frame over tensorIn's mapped memory
+    size_t frames = 0;               // frames filled in for the current submission
+
+    // Set by the engine
+    uint32_t stream = 0;
+    size_t index = 0;   // position within the stream, 0 .. framesPerStream() - 1
+    uint32_t rows = 0;  // output rows the recorded dispatch computes
+    GpuTimings timings; // of the last submission, once poll() has returned the frame
+
+    // Read-back output of batched frame f (config.readback only)
+    const uint32_t* output(size_t f) const;
+
+    // Buffer holding RGBA output for presentation (config.presentable or RGBA output)
+    const std::shared_ptr<vk::Buffer>& presentBuffer() const;
+
+private:
+    friend class GpuEngine;
+
+    std::shared_ptr<kp::TensorT<uint32_t>> tensorIn;
+    std::shared_ptr<kp::TensorT<uint32_t>> tensorOut;
+    std::shared_ptr<kp::TensorT<uint32_t>> tensorDisplay; // compact + presentable: expanded RGBA
+    std::shared_ptr<kp::Algorithm> algorithm;             // fused/tiled
+    std::shared_ptr<kp::Algorithm> expand;                // fills tensorDisplay
+    std::unique_ptr<PassGraph> graph; // own transients, since frames overlap on the GPU
+    std::shared_ptr<kp::Sequence> seq;
+    std::shared_ptr<vk::Buffer> outputBuffer;
+    size_t outputFrameWords = 0;
+    bool inFlight = false;
+};
+
+// Owns the Kompute manager and every tensor, pipeline and sequence of the edge pipeline, so
+// callers only fill input views, submit() and poll().
+//
+// Each stream has framesInFlight frames and submits them in order on one compute queue
+// (stream % queues); streams do not wait on each other.
+class GpuEngine
+{
+public:
+    static constexpr uint32_t kAllRows = std::numeric_limits<uint32_t>::max();
+
+    // Creates its own compute-only instance and device (render nodes, lavapipe in CI).
+    explicit GpuEngine(const GpuEngineConfig& config);
+
+    // Runs on a device the caller created, e.g. VulkanDisplay's, so output buffers can be
+    // copied straight into its swapchain. Uses that device's first compute queue.
+    GpuEngine(const GpuEngineConfig& config,
+              std::shared_ptr<vk::Instance> instance,
+              std::shared_ptr<vk::PhysicalDevice> physicalDevice,
+              std::shared_ptr<vk::Device> device);
+
+    GpuEngine(const GpuEngine&) = delete;
+    GpuEngine& operator=(const GpuEngine&) = delete;
+
+    size_t framesPerStream() const;
+    GpuFrame& frame(uint32_t stream, size_t index);
+
+    // Uploads frame's inputs and starts processing. With rows < all output rows (fused/tiled,
+    // batch 1) only the top `rows` rows are computed; changing it re-records the frame.
+    void submit(GpuFrame& frame, uint32_t rows = kAllRows);
+
+    // Waits for the stream's oldest submitted frame and returns it, or nullptr if the stream
+    // has nothing in flight. Frames complete in submission order within a stream.
+    GpuFrame* poll(uint32_t stream);
+
+    size_t inFlight(uint32_t stream) const;
+
+    const GpuEngineConfig& config() const;
+    WorkgroupShape workgroup() const;
+    bool timestampsSupported() const;
+    size_t outputFrameWords() const;
+
+    // Pass graph of the first frame, for reporting; nullptr unless shader is "graph"
+    const PassGraph* graph() const;
+
+    // Startup cost: Vulkan device creation, then pipelines and workgroup autotuning
+    double deviceMs() const;
+    double pipelineMs() const;
+
+private:
+    void build();
+    void record(GpuFrame& frame);
+
+    GpuEngineConfig mConfig;
+    std::unique_ptr<kp::Manager> mMgr;
+    std::vector<std::vector<GpuFrame>> mFrames;  // [stream][index]
+    std::vector<std::deque<GpuFrame*>> mPending; // per stream, oldest first
+    WorkgroupShape mWorkgroup{16, 16};
+    uint32_t mDispatchOps = 1; // recorded ops between the upload and the readback
+    bool mTimestamps = false;
+    double mTimestampPeriodNs = 0.0;
+    size_t mOutputFrameWords = 0;
+    double mDeviceMs = 0.0;
+    double mPipelineMs = 0.0;
+};
@@ -0,0 +1,220 @@
+#include "hybrid_rows.hpp"
+
+#ifdef HAVE_LAB6_KERNELS
+#include "processing.hpp"
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+using cv::Mat;
+using std::runtime_error;
+using std::unique_lock;
+
+namespace {
+
+#ifndef HAVE_LAB6_KERNELS
+// BT.709 in 8-bit fixed point (54/183/19, truncated), as in lab6's to442_grayscale and
+// the fused and tiled shaders, so CPU and GPU rows of a frame are identical
+void gray_rows_scalar(const Mat& bgr, Mat& gray, int r0, int r1)
+{
+    for (int y = r0; y < r1; ++y) {
+        const uchar* src = bgr.ptr<uchar>(y);
+        uchar* dst = gray.ptr<uchar>(y);
+        for (int x = 0; x < bgr.cols; ++x) {
+            dst[x] = static_cast<uchar>((19 * src[3 * x] + 183 * src[3 * x + 1] + 54 * src[3 * x + 2]) >> 8);
+        }
+    }
+}
+#endif
+
+// Saturated |Gx| + |Gy| for output row y, columns [x0, dst.cols)
+void sobel_row_scalar(const Mat& gray, Mat& dst, int y, int x0)
+{
+    const uchar* t = gray.ptr<uchar>(y);
+    const uchar* m = gray.ptr<uchar>(y + 1);
+    const uchar* b = gray.ptr<uchar>(y + 2);
+    uchar* out = dst.ptr<uchar>(y);
+    for (int x = x0; x < dst.cols; ++x) {
+        const int gx = (t[x + 2] + 2 * m[x + 2] + b[x + 2]) - (t[x] + 2 * m[x] + b[x]);
+        const int gy = (t[x] + 2 * t[x + 1] + t[x + 2]) - (b[x] + 2 * b[x + 1] + b[x + 2]);
+        out[x] = static_cast<uchar>(std::min(std::abs(gx) + std::abs(gy), 255));
+    }
+}
+
+// Output rows [r0, r1) read input rows [r0, r1 + 2). The gray rows go to the calling
+// worker's own scratch, grown as needed, so no other thread touches them.
+void edge_rows(Mat& bgr, Mat& scratch, Mat& dst, int r0, int r1)
+{
+    const int h = r1 - r0 + 2;
+    if (scratch.rows < h || scratch.cols != bgr.cols) {
+        scratch.create(h, bgr.cols, CV_8UC1);
+    }
+    Mat src = bgr.rowRange(r0, r0 + h);
+    Mat gray = scratch.rowRange(0, h);
+    Mat out = dst.rowRange(r0, r1);
+#ifdef HAVE_LAB6_KERNELS
+    to442_grayscale(&src, &gray, 0, 0, h, bgr.cols);
+    to442_sobel(&gray, &out, 0, 0, h, bgr.cols);
+    // to442_sobel only writes whole groups of 8 pixels; finish the right edge here
+    const int vectorCols = out.cols / 8 * 8;
+    for (int y = 0; y < out.rows && vectorCols < out.cols; ++y) {
+        sobel_row_scalar(gray, out, y, vectorCols);
+    }
+#else
+    gray_rows_scalar(src, gray, 0, h);
+    for (int y = 0; y < out.rows; ++y) {
+        sobel_row_scalar(gray, out, y, 0);
+    }
+#endif
+}
+
+// Same cutoff as the shaders' mask output: set where the magnitude is >= threshold
+void mask_rows(Mat& dst, int r0, int r1, int threshold)
+{
+    for (int y = r0; y < r1; ++y) {
+        uchar* row = dst.ptr<uchar>(y);
+        for (int x = 0; x < dst.cols; ++x) {
+            row[x] = row[x] >= threshold ? 255 : 0;
+        }
+    }
+}
+
+} // namespace
+
+CpuEdgeWorkers::CpuEdgeWorkers(unsigned threads, int maskThreshold)
+    : mMaskThreshold(maskThreshold)
+{
+    if (threads == 0) {
+        throw runtime_error("CpuEdgeWorkers: need at least one thread.");
+    }
+    mGray.resize(threads);
+    for (unsigned i = 0; i < threads; ++i) {
+        mThreads.emplace_back(&CpuEdgeWorkers::run, this, i);
+    }
+}
+
+CpuEdgeWorkers::~CpuEdgeWorkers()
+{
+    {
+        unique_lock<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mStartCv.notify_all();
+    for (std::thread& thread : mThreads) {
+        thread.join();
+    }
+}
+
+void CpuEdgeWorkers::start(Mat& bgr, Mat& dst, int firstRow)
+{
+    if (bgr.type() != CV_8UC3 || dst.type() != CV_8UC1 ||
+        dst.rows != bgr.rows - 2 || dst.cols != bgr.cols - 2) {
+        throw runtime_error("CpuEdgeWorkers: expected a BGR frame and an (H-2)x(W-2) gray output.");
+    }
+    {
+        unique_lock<std::mutex> lock(mMutex);
+        if (mRunning > 0) {
+            throw runtime_error("CpuEdgeWorkers: start() called while a frame is in progress.");
+        }
+        mSrc = &bgr;
+        mDst = &dst;
+        mFirstRow = std::clamp(firstRow, 0, dst.rows);
+        mRunning = static_cast<unsigned>(mThreads.size());
+        mStartTicks = cv::getTickCount();
+        mGeneration++;
+    }
+    mStartCv.notify_all();
+}
+
+double CpuEdgeWorkers::wait()
+{
+    unique_lock<std::mutex> lock(mMutex);
+    mDoneCv.wait(lock, [this] { return mRunning == 0; });
+    return mElapsedMs;
+}
+
+unsigned CpuEdgeWorkers::threadCount() const
+{
+    return static_cast<unsigned>(mThreads.size());
+}
+
+void CpuEdgeWorkers::run(unsigned index)
+{
+    uint64_t seen = 0;
+    while (true) {
+        unique_lock<std::mutex> lock(mMutex);
+        mStartCv.wait(lock, [&] { return mStopping || mGeneration != seen; });
+        if (mStopping) {
+            return;
+        }
+        seen = mGeneration;
+        Mat& src = *mSrc;
+        Mat& dst = *mDst;
+        const int64_t rows = dst.rows - mFirstRow;
+        const int64_t threads = static_cast<int64_t>(mThreads.size());
+        const int r0 = mFirstRow + static_cast<int>(rows * index / threads);
+        const int r1 = mFirstRow + static_cast<int>(rows * (index + 1) / threads);
+        lock.unlock();
+
+        if (r1 > r0) {
+            edge_rows(src, mGray[index], dst, r0, r1);
+            if (mMaskThreshold >= 0) {
+                mask_rows(dst, r0, r1, mMaskThreshold);
+            }
+        }
+
+        lock.lock();
+        if (--mRunning == 0) {
+            mElapsedMs = (cv::getTickCount() - mStartTicks) * 1000.0 / cv::getTickFrequency();
+            mDoneCv.notify_all();
+        }
+    }
+}
+
+RowSplitter::RowSplitter(uint32_t totalRows, uint32_t granularity, double initialGpuShare)
+    : mTotalRows(totalRows)
+    , mGranularity(std::max(granularity, 1u))
+    , mShare(initialGpuShare)
+{
+    quantize();
+}
+
+uint32_t RowSplitter::gpuRows() const
+{
+    return mGpuRows;
+}
+
+double RowSplitter::gpuShare() const
+{
+    return mShare;
+}
+
+void RowSplitter::update(uint32_t gpuRowsDone, double gpuMs, double cpuMs)
+{
+    const uint32_t cpuRowsDone = mTotalRows - std::min(gpuRowsDone, mTotalRows);
+    if (gpuRowsDone == 0 || cpuRowsDone == 0 || gpuMs <= 0.0 || cpuMs <= 0.0) {
+        return;
+    }
+    // Equal finish times means splitting rows in proportion to throughput. Smoothed, since a
+    // single frame's timings are noisy (decode on the main thread competes with the workers).
+    const double gpuRate = gpuRowsDone / gpuMs;
+    const double cpuRate = cpuRowsDone / cpuMs;
+    const double target = gpuRate / (gpuRate + cpuRate);
+    mShare = 0.75 * mShare + 0.25 * target;
+    quantize();
+}
+
+// Both sides keep at least one workgroup row so their rates can still be measured.
+void RowSplitter::quantize()
+{
+    if (mTotalRows <= 2 * mGranularity) {
+        mGpuRows = mTotalRows;
+        return;
+    }
+    const double steps = std::round(mShare * mTotalRows / mGranularity);
+    const uint32_t maxRows = (mTotalRows - 1) / mGranularity * mGranularity;
+    mGpuRows = std::clamp(static_cast<uint32_t>(steps) * mGranularity, mGranularity, maxRows);
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <opencv2/opencv.hpp>
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// CPU half of --hybrid: a fixed pool of threads that computes the bottom rows of a frame's
+// Sobel output from its BGR input while the GPU computes the top rows.
+//
+// Uses lab6's NEON grayscale/Sobel kernels when built with HAVE_LAB6_KERNELS (aarch64),
+// a scalar version of the same integer math otherwise.
+class CpuEdgeWorkers
+{
+public:
+    // maskThreshold >= 0: output rows are 255 where the magnitude is at least the threshold
+    // and 0 elsewhere, matching what the GPU's mask output unpacks to; -1 keeps magnitudes.
+    explicit CpuEdgeWorkers(unsigned threads, int maskThreshold = -1);
+    ~CpuEdgeWorkers();
+
+    CpuEdgeWorkers(const CpuEdgeWorkers&) = delete;
+    CpuEdgeWorkers& operator=(const CpuEdgeWorkers&) = delete;
+
+    // Starts writing output rows [firstRow, dst.rows) of dst ((H-2)x(W-2), CV_8UC1) from bgr
+    // (HxW, CV_8UC3), split into one band per thread. Both must stay alive until wait().
+    void start(cv::Mat& bgr, cv::Mat& dst, int firstRow);
+
+    // Blocks until the frame passed to start() is done; returns its CPU wall time in ms.
+    double wait();
+
+    unsigned threadCount() const;
+
+private:
+    void run(unsigned index);
+
+    std::vector<std::thread> mThreads;
+    std::mutex mMutex;
+    std::condition_variable mStartCv;
+    std::condition_variable mDoneCv;
+    uint64_t mGeneration = 0; // bumped by start(); each worker runs every generation once
+    unsigned mRunning = 0;
+    bool mStopping = false;
+
+    cv::Mat* mSrc = nullptr;
+    cv::Mat* mDst = nullptr;
+    // Per-worker gray scratch, band plus the two halo rows Sobel reads. Private, since
+    // neighbouring bands both need the rows at their boundary.
+    std::vector<cv::Mat> mGray;
+    int mFirstRow = 0;
+    int mMaskThreshold = -1;
+    int64_t mStartTicks = 0;
+    double mElapsedMs = 0.0;
+};
+
+// Decides how many output rows go to the GPU. After every frame the split moves toward the
+// point where both sides, at their measured rows-per-ms, would finish at the same time.
+class RowSplitter
+{
+public:
+    // granularity: the GPU share is kept a multiple of this (the workgroup height)
+    RowSplitter(uint32_t totalRows, uint32_t granularity, double initialGpuShare);
+
+    uint32_t gpuRows() const;
+    double gpuShare() const;
+
+    void update(uint32_t gpuRowsDone, double gpuMs, double cpuMs);
+
+private:
+    void quantize();
+
+    uint32_t mTotalRows;
+    uint32_t mGranularity;
+    double mShare;
+    uint32_t mGpuRows = 0;
+};
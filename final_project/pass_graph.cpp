@@ -0,0 +1,239 @@
+#include "pass_graph.hpp"
+
+#include <algorithm>
+#include <set>
+#include <stdexcept>
+
+using std::runtime_error;
+using std::set;
+using std::shared_ptr;
+using std::string;
+using std::vector;
+
+PassGraph::PassGraph(kp::Manager& mgr)
+    : mMgr(mgr)
+{
+}
+
+PassGraph::BufferId PassGraph::importBuffer(const shared_ptr<kp::Memory>& memory)
+{
+    if (mCompiled) {
+        throw runtime_error("PassGraph: cannot add buffers after compile().");
+    }
+    Buffer buffer;
+    buffer.name = "imported";
+    buffer.physical = mPhysical.size();
+    mPhysical.push_back(memory);
+    mBuffers.push_back(buffer);
+    return mBuffers.size() - 1;
+}
+
+PassGraph::BufferId PassGraph::createTransient(const string& name, uint32_t words)
+{
+    if (mCompiled) {
+        throw runtime_error("PassGraph: cannot add buffers after compile().");
+    }
+    Buffer buffer;
+    buffer.name = name;
+    buffer.words = words;
+    buffer.transient = true;
+    mBuffers.push_back(buffer);
+    mTransientCount++;
+    return mBuffers.size() - 1;
+}
+
+void PassGraph::addPass(
+    const string& name,
+    const vector<uint32_t>& spirv,
+    const vector<BufferId>& reads,
+    const vector<BufferId>& writes,
+    const kp::Workgroup& workgroups,
+    const vector<uint32_t>& specConsts,
+    const vector<uint32_t>& pushConsts)
+{
+    if (mCompiled) {
+        throw runtime_error("PassGraph: cannot add passes after compile().");
+    }
+    const int passIndex = static_cast<int>(mPasses.size());
+    for (const vector<BufferId>* ids : { &reads, &writes }) {
+        for (BufferId id : *ids) {
+            if (id >= mBuffers.size()) {
+                throw runtime_error("PassGraph: pass " + name + " uses an unknown buffer.");
+            }
+            Buffer& buffer = mBuffers[id];
+            if (buffer.firstUse < 0) {
+                buffer.firstUse = passIndex;
+            }
+            buffer.lastUse = passIndex;
+        }
+    }
+    mPasses.push_back({ name, spirv, reads, writes, workgroups, specConsts, pushConsts, nullptr });
+}
+
+void PassGraph::compile()
+{
+    if (mCompiled) {
+        return;
+    }
+    assignPhysical();
+
+    for (Pass& pass : mPasses) {
+        vector<shared_ptr<kp::Memory>> params;
+        for (BufferId id : pass.reads) {
+            params.push_back(mPhysical[mBuffers[id].physical]);
+        }
+        for (BufferId id : pass.writes) {
+            params.push_back(mPhysical[mBuffers[id].physical]);
+        }
+        pass.algorithm = mMgr.algorithm<uint32_t, uint32_t>(
+            params, pass.spirv, pass.workgroups, pass.specConsts, pass.pushConsts);
+    }
+
+    planBarriers();
+    mCompiled = true;
+}
+
+// Greedy interval allocation: each transient, in order of first use, takes the smallest
+// free tensor big enough for it whose previous occupant was last used by an earlier pass.
+void PassGraph::assignPhysical()
+{
+    vector<BufferId> order;
+    for (BufferId id = 0; id < mBuffers.size(); ++id) {
+        if (mBuffers[id].transient && mBuffers[id].firstUse >= 0) {
+            order.push_back(id);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [this](BufferId a, BufferId b) {
+        return mBuffers[a].firstUse < mBuffers[b].firstUse;
+    });
+
+    struct Slot
+    {
+        size_t physical;
+        uint32_t words;
+        int lastUse;
+    };
+    vector<Slot> slots;
+
+    for (BufferId id : order) {
+        Buffer& buffer = mBuffers[id];
+        Slot* best = nullptr;
+        for (Slot& slot : slots) {
+            if (slot.lastUse < buffer.firstUse && slot.words >= buffer.words &&
+                (!best || slot.words < best->words)) {
+                best = &slot;
+            }
+        }
+        if (!best) {
+            vector<uint32_t> init(buffer.words, 0);
+            mPhysical.push_back(mMgr.tensorT<uint32_t>(init, kp::Memory::MemoryTypes::eDevice));
+            slots.push_back({ mPhysical.size() - 1, buffer.words, -1 });
+            best = &slots.back();
+        }
+        best->lastUse = buffer.lastUse;
+        buffer.physical = best->physical;
+    }
+}
+
+// Tracks, per physical buffer, whether it has been written or read since the last barrier
+// covering it. Aliased transients share a physical buffer, so reuse gets its WAR barrier too.
+void PassGraph::planBarriers()
+{
+    set<size_t> written;
+    set<size_t> read;
+
+    for (size_t p = 0; p < mPasses.size(); ++p) {
+        const Pass& pass = mPasses[p];
+
+        set<size_t> readHazards;
+        for (BufferId id : pass.reads) {
+            const size_t physical = mBuffers[id].physical;
+            if (written.count(physical)) {
+                readHazards.insert(physical);
+            }
+        }
+        set<size_t> writeHazards;
+        for (BufferId id : pass.writes) {
+            const size_t physical = mBuffers[id].physical;
+            if ((written.count(physical) || read.count(physical)) && !readHazards.count(physical)) {
+                writeHazards.insert(physical);
+            }
+        }
+
+        for (const auto& [hazards, dstAccess] : {
+                 std::make_pair(&readHazards, vk::AccessFlagBits::eShaderRead),
+                 std::make_pair(&writeHazards, vk::AccessFlagBits::eShaderWrite) }) {
+            if (hazards->empty()) {
+                continue;
+            }
+            Step barrier;
+            barrier.dstAccess = dstAccess;
+            for (size_t physical : *hazards) {
+                barrier.memory.push_back(mPhysical[physical]);
+                written.erase(physical);
+                read.erase(physical);
+            }
+            mSteps.push_back(barrier);
+        }
+
+        Step dispatch;
+        dispatch.pass = static_cast<int>(p);
+        mSteps.push_back(dispatch);
+
+        for (BufferId id : pass.reads) {
+            read.insert(mBuffers[id].physical);
+        }
+        for (BufferId id : pass.writes) {
+            written.insert(mBuffers[id].physical);
+        }
+    }
+}
+
+void PassGraph::record(const shared_ptr<kp::Sequence>& seq) const
+{
+    if (!mCompiled) {
+        throw runtime_error("PassGraph: record() called before compile().");
+    }
+    for (const Step& step : mSteps) {
+        if (step.pass >= 0) {
+            seq->record<kp::OpAlgoDispatch>(mPasses[step.pass].algorithm);
+        }
+        else {
+            seq->record<kp::OpMemoryBarrier>(
+                step.memory,
+                vk::AccessFlagBits::eShaderWrite,
+                step.dstAccess,
+                vk::PipelineStageFlagBits::eComputeShader,
+                vk::PipelineStageFlagBits::eComputeShader);
+        }
+    }
+}
+
+uint32_t PassGraph::recordedOps() const
+{
+    return static_cast<uint32_t>(mSteps.size());
+}
+
+size_t PassGraph::passCount() const
+{
+    return mPasses.size();
+}
+
+size_t PassGraph::barrierCount() const
+{
+    return mSteps.size() - mPasses.size();
+}
+
+size_t PassGraph::transientCount() const
+{
+    return mTransientCount;
+}
+
+size_t PassGraph::allocatedTransients() const
+{
+    size_t imported = 0;
+    for (const Buffer& buffer : mBuffers) {
+        imported += buffer.transient ? 0 : 1;
+    }
+    return mPhysical.size() - imported;
+}
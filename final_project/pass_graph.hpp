@@ -0,0 +1,92 @@
+#pragma once
+
+#include <kompute/Kompute.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Chain of compute passes recorded into a single kp::Sequence.
+//
+// Passes declare which buffers they read and write; compile() then
+//  - places transient buffers whose lifetimes do not overlap in the same device tensor, and
+//  - plans a compute->compute barrier only where a pass touches a buffer an earlier pass
+//    wrote (or overwrites one an earlier pass read) since the last barrier on it.
+// Shader bindings follow the order of the pass's reads, then its writes.
+class PassGraph
+{
+public:
+    using BufferId = size_t;
+
+    explicit PassGraph(kp::Manager& mgr);
+
+    // Buffer owned by the caller (e.g. a frame's input/output tensor); never aliased.
+    BufferId importBuffer(const std::shared_ptr<kp::Memory>& memory);
+
+    // Intermediate buffer of `words` 32-bit elements, only valid between its first and last use.
+    BufferId createTransient(const std::string& name, uint32_t words);
+
+    void addPass(
+        const std::string& name,
+        const std::vector<uint32_t>& spirv,
+        const std::vector<BufferId>& reads,
+        const std::vector<BufferId>& writes,
+        const kp::Workgroup& workgroups,
+        const std::vector<uint32_t>& specConsts,
+        const std::vector<uint32_t>& pushConsts);
+
+    // Allocates the transient tensors and creates every pass's pipeline.
+    void compile();
+
+    // Records the passes and planned barriers; adds recordedOps() operations to seq.
+    void record(const std::shared_ptr<kp::Sequence>& seq) const;
+
+    uint32_t recordedOps() const;
+    size_t passCount() const;
+    size_t barrierCount() const;
+    size_t transientCount() const;
+    size_t allocatedTransients() const;
+
+private:
+    struct Buffer
+    {
+        std::string name;
+        uint32_t words = 0;
+        bool transient = false;
+        int firstUse = -1;
+        int lastUse = -1;
+        size_t physical = 0; // index into mPhysical
+    };
+
+    struct Pass
+    {
+        std::string name;
+        std::vector<uint32_t> spirv;
+        std::vector<BufferId> reads;
+        std::vector<BufferId> writes;
+        kp::Workgroup workgroups;
+        std::vector<uint32_t> specConsts;
+        std::vector<uint32_t> pushConsts;
+        std::shared_ptr<kp::Algorithm> algorithm;
+    };
+
+    // Either a barrier over `memory` or, when pass >= 0, that pass's dispatch
+    struct Step
+    {
+        int pass = -1;
+        std::vector<std::shared_ptr<kp::Memory>> memory;
+        vk::AccessFlagBits dstAccess = vk::AccessFlagBits::eShaderRead;
+    };
+
+    void assignPhysical();
+    void planBarriers();
+
+    kp::Manager& mMgr;
+    std::vector<Buffer> mBuffers;
+    std::vector<Pass> mPasses;
+    std::vector<std::shared_ptr<kp::Memory>> mPhysical;
+    std::vector<Step> mSteps;
+    size_t mTransientCount = 0;
+    bool mCompiled = false;
+};
@@ -0,0 +1,103 @@
+#include "stage_histogram.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <utility>
+
+using std::max;
+using std::min;
+using std::ostream;
+using std::setw;
+using std::string;
+
+StageHistogram::StageHistogram(string name)
+    : mName(std::move(name))
+{
+}
+
+void StageHistogram::add(double ms)
+{
+    const double us = ms * 1000.0;
+    size_t bucket = 0;
+    if (us >= 1.0) {
+        bucket = min(static_cast<size_t>(std::log2(us) * kStepsPerOctave) + 1, kBuckets - 1);
+    }
+    mBuckets[bucket]++;
+
+    mMinMs = mCount == 0 ? ms : min(mMinMs, ms);
+    mMaxMs = mCount == 0 ? ms : max(mMaxMs, ms);
+    mSumMs += ms;
+    mCount++;
+
+    if (mLatency) {
+        metrics_observe_ns(mLatency, static_cast<uint64_t>(max(ms, 0.0) * 1e6));
+    }
+}
+
+void StageHistogram::publish(metricLatency_t* latency)
+{
+    mLatency = latency;
+}
+
+size_t StageHistogram::count() const
+{
+    return mCount;
+}
+
+double StageHistogram::meanMs() const
+{
+    return mCount ? mSumMs / mCount : 0.0;
+}
+
+double StageHistogram::bucketUpperMs(size_t bucket)
+{
+    // Bucket 0 holds everything under 1 us, bucket i >= 1 ends at 2^(i / kStepsPerOctave) us
+    return std::exp2(static_cast<double>(bucket) / kStepsPerOctave) / 1000.0;
+}
+
+double StageHistogram::percentileMs(double q) const
+{
+    if (mCount == 0) {
+        return 0.0;
+    }
+    const double target = q * mCount;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        seen += mBuckets[i];
+        if (seen >= target && mBuckets[i] > 0) {
+            return min(bucketUpperMs(i), mMaxMs);
+        }
+    }
+    return mMaxMs;
+}
+
+void StageHistogram::print(ostream& os) const
+{
+    if (mCount == 0) {
+        return;
+    }
+    const std::ios::fmtflags flags = os.flags();
+    const std::streamsize precision = os.precision();
+    os << std::fixed << std::setprecision(3);
+
+    os << mName << ": n=" << mCount
+       << " mean " << meanMs() << " ms, min " << mMinMs << ", max " << mMaxMs
+       << ", p50 <= " << percentileMs(0.50)
+       << ", p95 <= " << percentileMs(0.95)
+       << ", p99 <= " << percentileMs(0.99) << " ms" << "\n";
+
+    const uint64_t tallest = *std::max_element(mBuckets.begin(), mBuckets.end());
+    const int barWidth = 40;
+    for (size_t i = 0; i < kBuckets; ++i) {
+        if (mBuckets[i] == 0) {
+            continue;
+        }
+        const double lower = i == 0 ? 0.0 : bucketUpperMs(i - 1);
+        const int bar = static_cast<int>((mBuckets[i] * barWidth + tallest - 1) / tallest);
+        os << "  " << setw(9) << lower << " - " << setw(9) << bucketUpperMs(i) << " ms | "
+           << string(bar, '#') << " " << mBuckets[i] << "\n";
+    }
+    os.flags(flags);
+    os.precision(precision);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "metrics.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Latency histogram for one pipeline stage. Buckets are quarter-octaves from 1 us up, so adding
+// a sample is O(1) and memory stays fixed however long the stream runs.
+class StageHistogram
+{
+public:
+    explicit StageHistogram(std::string name);
+
+    void add(double ms);
+
+    // Also feed every sample into a live metric (lab6/metrics.hpp)
+    void publish(metricLatency_t* latency);
+
+    size_t count() const;
+    double meanMs() const;
+
+    // Upper edge of the bucket holding quantile q (0-1), i.e. at most ~19% high
+    double percentileMs(double q) const;
+
+    // One summary line, then one bar per non-empty bucket
+    void print(std::ostream& os) const;
+
+private:
+    static constexpr size_t kStepsPerOctave = 4;
+    static constexpr size_t kBuckets = 24 * kStepsPerOctave + 1; // 1 us .. ~16 s, the last is open
+
+    static double bucketUpperMs(size_t bucket);
+
+    std::string mName;
+    metricLatency_t* mLatency = nullptr;
+    std::array<uint64_t, kBuckets> mBuckets{};
+    size_t mCount = 0;
+    double mSumMs = 0.0;
+    double mMinMs = 0.0;
+    double mMaxMs = 0.0;
+};
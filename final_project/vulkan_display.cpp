@@ -13,8 +13,8 @@ using std::numeric_limits;
 using std::runtime_error;
 using std::vector;
 
-VulkanDisplay::VulkanDisplay(uint32_t width, uint32_t height)
-    : mWindowWidth(width), mWindowHeight(height)
+VulkanDisplay::VulkanDisplay(uint32_t width, uint32_t height, uint32_t framesInFlight)
+    : mWindowWidth(width), mWindowHeight(height), mFramesInFlight(std::max(framesInFlight, 1u))
 {
     try {
         initWindow();
@@ -56,35 +56,57 @@ void VulkanDisplay::pollEvents() const
     glfwPollEvents();
 }
 
-void VulkanDisplay::presentFromBuffer(
+uint64_t VulkanDisplay::presentFromBuffer(
     const vk::Buffer& sourceBuffer,
     uint32_t sourceWidth,
     uint32_t sourceHeight)
 {
-    const array<vk::Fence, 1> inFlightFences = { mInFlightFence };
-    mDevice->waitForFences(inFlightFences, VK_TRUE, numeric_limits<uint64_t>::max());
-    mDevice->resetFences(inFlightFences);
+    // Only this frame's own previous submission has to finish; the other frames in flight
+    // keep copying and presenting meanwhile.
+    FrameSync& frame = mFrames.at(mCurrentFrame);
+    waitForFrame(mCurrentFrame);
 
     uint32_t imageIndex = 0;
-    const vk::Result acquireResult = mDevice->acquireNextImageKHR(
-        mSwapchain,
-        numeric_limits<uint64_t>::max(),
-        mImageAvailableSemaphore,
-        vk::Fence(),
-        &imageIndex);
-
-    if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
-        return;
+    while (true) {
+        const vk::Result acquireResult = mDevice->acquireNextImageKHR(
+            mSwapchain,
+            numeric_limits<uint64_t>::max(),
+            frame.imageAvailable,
+            vk::Fence(),
+            &imageIndex);
+
+        if (acquireResult == vk::Result::eErrorOutOfDateKHR) {
+            if (shouldClose()) {
+                return 0; // closed while minimised; nothing was submitted
+            }
+            recreateSwapchain();
+            continue;
+        }
+        if (acquireResult != vk::Result::eSuccess && acquireResult != vk::Result::eSuboptimalKHR) {
+            throw runtime_error("Failed to acquire swapchain image.");
+        }
+        break;
     }
-    if (acquireResult != vk::Result::eSuccess && acquireResult != vk::Result::eSuboptimalKHR) {
-        throw runtime_error("Failed to acquire swapchain image.");
+
+    // With more frames in flight than swapchain images, an older frame may still own this image.
+    if (mImagesInFlight.at(imageIndex) && mImagesInFlight.at(imageIndex) != frame.inFlight) {
+        const array<vk::Fence, 1> imageFences = { mImagesInFlight.at(imageIndex) };
+        mDevice->waitForFences(imageFences, VK_TRUE, numeric_limits<uint64_t>::max());
     }
+    mImagesInFlight.at(imageIndex) = frame.inFlight;
+
+    const array<vk::Fence, 1> inFlightFences = { frame.inFlight };
+    mDevice->resetFences(inFlightFences);
 
-    vk::CommandBuffer cmd = mCommandBuffers.at(imageIndex);
+    const uint32_t firstQuery = 2 * mCurrentFrame;
+    vk::CommandBuffer cmd = frame.commandBuffer;
     cmd.reset(vk::CommandBufferResetFlags());
 
     const vk::CommandBufferBeginInfo beginInfo(vk::CommandBufferUsageFlagBits::eOneTimeSubmit);
     cmd.begin(beginInfo);
+    if (mTimestampPool) {
+        cmd.resetQueryPool(mTimestampPool, firstQuery, 2);
+    }
 
     vk::BufferMemoryBarrier bufferBarrier{};
     bufferBarrier.srcAccessMask = vk::AccessFlagBits::eShaderWrite;
@@ -142,11 +164,17 @@ void VulkanDisplay::presentFromBuffer(
     copyRegion.imageOffset = vk::Offset3D(0, 0, 0);
     copyRegion.imageExtent = copyExtent;
 
+    if (mTimestampPool) {
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTransfer, mTimestampPool, firstQuery);
+    }
     cmd.copyBufferToImage(
         sourceBuffer,
         mSwapchainImages.at(imageIndex),
         vk::ImageLayout::eTransferDstOptimal,
         copyRegion);
+    if (mTimestampPool) {
+        cmd.writeTimestamp(vk::PipelineStageFlagBits::eTransfer, mTimestampPool, firstQuery + 1);
+    }
 
     vk::ImageMemoryBarrier toPresentBarrier{};
     toPresentBarrier.srcAccessMask = vk::AccessFlagBits::eTransferWrite;
@@ -174,28 +202,94 @@ void VulkanDisplay::presentFromBuffer(
     const vk::PipelineStageFlags waitStage = vk::PipelineStageFlagBits::eTransfer;
     vk::SubmitInfo submitInfo{};
     submitInfo.waitSemaphoreCount = 1;
-    submitInfo.pWaitSemaphores = &mImageAvailableSemaphore;
+    submitInfo.pWaitSemaphores = &frame.imageAvailable;
     submitInfo.pWaitDstStageMask = &waitStage;
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &cmd;
     submitInfo.signalSemaphoreCount = 1;
-    submitInfo.pSignalSemaphores = &mRenderFinishedSemaphore;
+    submitInfo.pSignalSemaphores = &mRenderFinishedSemaphores.at(imageIndex);
 
-    mQueue.submit(submitInfo, mInFlightFence);
+    mQueue.submit(submitInfo, frame.inFlight);
+    frame.ticket = mNextTicket++;
+    frame.timestampsPending = static_cast<bool>(mTimestampPool);
+    mCurrentFrame = (mCurrentFrame + 1) % mFramesInFlight;
 
     vk::PresentInfoKHR presentInfo{};
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = &mRenderFinishedSemaphore;
+    presentInfo.pWaitSemaphores = &mRenderFinishedSemaphores.at(imageIndex);
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = &mSwapchain;
     presentInfo.pImageIndices = &imageIndex;
 
-    const vk::Result presentResult = mQueue.presentKHR(presentInfo);
-    if (presentResult != vk::Result::eSuccess &&
-        presentResult != vk::Result::eSuboptimalKHR &&
-        presentResult != vk::Result::eErrorOutOfDateKHR) {
-        throw runtime_error("Failed to present swapchain image.");
+    // The frame was already copied; a stale swapchain only needs rebuilding for the next one.
+    // vulkan.hpp reports eErrorOutOfDateKHR from presentKHR as an exception.
+    bool recreate = false;
+    try {
+        recreate = mQueue.presentKHR(presentInfo) == vk::Result::eSuboptimalKHR;
+    }
+    catch (const vk::OutOfDateKHRError&) {
+        recreate = true;
     }
+    if (recreate) {
+        recreateSwapchain();
+    }
+    return frame.ticket;
+}
+
+void VulkanDisplay::waitForPresent(uint64_t ticket)
+{
+    for (uint32_t i = 0; i < mFrames.size(); ++i) {
+        if (ticket != 0 && mFrames[i].ticket == ticket) {
+            waitForFrame(i);
+            return;
+        }
+    }
+    // Not found: that frame's slot has been reused since, so its copy already completed.
+}
+
+void VulkanDisplay::waitForFrame(uint32_t frameIndex)
+{
+    FrameSync& frame = mFrames.at(frameIndex);
+    const array<vk::Fence, 1> fences = { frame.inFlight };
+    mDevice->waitForFences(fences, VK_TRUE, numeric_limits<uint64_t>::max());
+
+    if (frame.timestampsPending) {
+        array<uint64_t, 2> timestamps{};
+        const vk::Result queryResult = mDevice->getQueryPoolResults(
+            mTimestampPool, 2 * frameIndex, 2, sizeof(timestamps), timestamps.data(),
+            sizeof(uint64_t), vk::QueryResultFlagBits::e64);
+        if (queryResult == vk::Result::eSuccess) {
+            mCopyTimesMs.push_back((timestamps[1] - timestamps[0]) * mTimestampPeriodNs / 1e6);
+        }
+        frame.timestampsPending = false;
+    }
+}
+
+vector<double> VulkanDisplay::takeCopyTimes()
+{
+    vector<double> copyTimes;
+    copyTimes.swap(mCopyTimesMs);
+    return copyTimes;
+}
+
+void VulkanDisplay::recreateSwapchain()
+{
+    // A minimised window has a zero-sized surface; wait until it can be presented to again.
+    int framebufferWidth = 0;
+    int framebufferHeight = 0;
+    glfwGetFramebufferSize(mWindow, &framebufferWidth, &framebufferHeight);
+    while ((framebufferWidth == 0 || framebufferHeight == 0) && !glfwWindowShouldClose(mWindow)) {
+        glfwWaitEvents();
+        glfwGetFramebufferSize(mWindow, &framebufferWidth, &framebufferHeight);
+    }
+    if (framebufferWidth == 0 || framebufferHeight == 0) {
+        return;
+    }
+
+    mDevice->waitIdle();
+    destroySwapchain();
+    createSwapchain();
+    createSwapchainSyncObjects();
 }
 
 vk::SurfaceFormatKHR VulkanDisplay::chooseSurfaceFormat(const vector<vk::SurfaceFormatKHR>& formats)
@@ -274,6 +368,7 @@ void VulkanDisplay::initVulkan()
     createCommandPool();
     createCommandBuffers();
     createSyncObjects();
+    createTimestampQueries();
 }
 
 void VulkanDisplay::createInstance()
@@ -461,19 +556,65 @@ void VulkanDisplay::createCommandBuffers()
     const vk::CommandBufferAllocateInfo allocInfo(
         mCommandPool,
         vk::CommandBufferLevel::ePrimary,
-        static_cast<uint32_t>(mSwapchainImages.size()));
+        mFramesInFlight);
 
-    mCommandBuffers = mDevice->allocateCommandBuffers(allocInfo);
+    const vector<vk::CommandBuffer> commandBuffers = mDevice->allocateCommandBuffers(allocInfo);
+    mFrames.resize(mFramesInFlight);
+    for (uint32_t i = 0; i < mFramesInFlight; ++i) {
+        mFrames[i].commandBuffer = commandBuffers[i];
+    }
 }
 
 void VulkanDisplay::createSyncObjects()
 {
     const vk::SemaphoreCreateInfo semaphoreInfo;
-    mImageAvailableSemaphore = mDevice->createSemaphore(semaphoreInfo);
-    mRenderFinishedSemaphore = mDevice->createSemaphore(semaphoreInfo);
-
     const vk::FenceCreateInfo fenceInfo(vk::FenceCreateFlagBits::eSignaled);
-    mInFlightFence = mDevice->createFence(fenceInfo);
+    for (FrameSync& frame : mFrames) {
+        frame.imageAvailable = mDevice->createSemaphore(semaphoreInfo);
+        frame.inFlight = mDevice->createFence(fenceInfo);
+    }
+    createSwapchainSyncObjects();
+}
+
+// Render-finished semaphores are per swapchain image: presentation may still be waiting on
+// one after the frame that signalled it has been reused.
+void VulkanDisplay::createSwapchainSyncObjects()
+{
+    const vk::SemaphoreCreateInfo semaphoreInfo;
+    mRenderFinishedSemaphores.clear();
+    for (size_t i = 0; i < mSwapchainImages.size(); ++i) {
+        mRenderFinishedSemaphores.push_back(mDevice->createSemaphore(semaphoreInfo));
+    }
+    mImagesInFlight.assign(mSwapchainImages.size(), vk::Fence());
+}
+
+void VulkanDisplay::destroySwapchain()
+{
+    for (vk::Semaphore semaphore : mRenderFinishedSemaphores) {
+        mDevice->destroySemaphore(semaphore);
+    }
+    mRenderFinishedSemaphores.clear();
+    mImagesInFlight.clear();
+
+    if (mSwapchain) {
+        mDevice->destroySwapchainKHR(mSwapchain);
+        mSwapchain = vk::SwapchainKHR();
+        mSwapchainImages.clear();
+    }
+}
+
+void VulkanDisplay::createTimestampQueries()
+{
+    const vector<vk::QueueFamilyProperties> queueFamilies =
+        mPhysicalDevice->getQueueFamilyProperties();
+    if (queueFamilies.at(mQueueFamilyIndex).timestampValidBits == 0) {
+        return; // copy timing is simply not reported
+    }
+    mTimestampPeriodNs = mPhysicalDevice->getProperties().limits.timestampPeriod;
+
+    const vk::QueryPoolCreateInfo queryPoolInfo(
+        vk::QueryPoolCreateFlags(), vk::QueryType::eTimestamp, 2 * mFramesInFlight);
+    mTimestampPool = mDevice->createQueryPool(queryPoolInfo);
 }
 
 void VulkanDisplay::cleanup()
@@ -481,28 +622,25 @@ void VulkanDisplay::cleanup()
     if (mDevice) {
         mDevice->waitIdle();
 
-        if (mInFlightFence) {
-            mDevice->destroyFence(mInFlightFence);
-            mInFlightFence = vk::Fence();
+        if (mTimestampPool) {
+            mDevice->destroyQueryPool(mTimestampPool);
+            mTimestampPool = vk::QueryPool();
         }
-        if (mImageAvailableSemaphore) {
-            mDevice->destroySemaphore(mImageAvailableSemaphore);
-            mImageAvailableSemaphore = vk::Semaphore();
-        }
-        if (mRenderFinishedSemaphore) {
-            mDevice->destroySemaphore(mRenderFinishedSemaphore);
-            mRenderFinishedSemaphore = vk::Semaphore();
+
+        for (FrameSync& frame : mFrames) {
+            if (frame.inFlight) {
+                mDevice->destroyFence(frame.inFlight);
+            }
+            if (frame.imageAvailable) {
+                mDevice->destroySemaphore(frame.imageAvailable);
+            }
         }
+        mFrames.clear();
         if (mCommandPool) {
             mDevice->destroyCommandPool(mCommandPool);
             mCommandPool = vk::CommandPool();
-            mCommandBuffers.clear();
-        }
-        if (mSwapchain) {
-            mDevice->destroySwapchainKHR(mSwapchain);
-            mSwapchain = vk::SwapchainKHR();
-            mSwapchainImages.clear();
         }
+        destroySwapchain();
     }
 
     if (mInstance && mSurface) {
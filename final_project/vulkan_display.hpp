@@ -13,7 +13,8 @@
 class VulkanDisplay
 {
 public:
-    VulkanDisplay(uint32_t width, uint32_t height);
+    // framesInFlight: presents that may be queued on the GPU before presentFromBuffer waits
+    VulkanDisplay(uint32_t width, uint32_t height, uint32_t framesInFlight = 2);
     ~VulkanDisplay();
 
     std::shared_ptr<vk::Instance> getInstance() const;
@@ -23,11 +24,21 @@ public:
     bool shouldClose() const;
     void pollEvents() const;
 
-    void presentFromBuffer(
+    // Queues a copy of sourceBuffer to the next swapchain image and presents it. Returns a
+    // ticket for waitForPresent; sourceBuffer must not be overwritten before that wait.
+    uint64_t presentFromBuffer(
         const vk::Buffer& sourceBuffer,
         uint32_t sourceWidth,
         uint32_t sourceHeight);
 
+    // Blocks until the copy queued by the present with this ticket has finished. Ticket 0
+    // and tickets whose frame has already been reused return immediately.
+    void waitForPresent(uint64_t ticket);
+
+    // GPU times of the copyBufferToImage calls completed since the last call, measured with
+    // timestamp queries. Empty if the queue does not support timestamps.
+    std::vector<double> takeCopyTimes();
+
 private:
     static vk::SurfaceFormatKHR chooseSurfaceFormat(
         const std::vector<vk::SurfaceFormatKHR>& formats);
@@ -48,6 +59,11 @@ private:
     void createCommandPool();
     void createCommandBuffers();
     void createSyncObjects();
+    void createSwapchainSyncObjects();
+    void createTimestampQueries();
+    void destroySwapchain();
+    void recreateSwapchain();
+    void waitForFrame(uint32_t frameIndex);
     void cleanup();
 
     uint32_t mWindowWidth = 0;
@@ -68,9 +84,24 @@ private:
     std::vector<vk::Image> mSwapchainImages;
 
     vk::CommandPool mCommandPool;
-    std::vector<vk::CommandBuffer> mCommandBuffers;
 
-    vk::Semaphore mImageAvailableSemaphore;
-    vk::Semaphore mRenderFinishedSemaphore;
-    vk::Fence mInFlightFence;
+    struct FrameSync
+    {
+        vk::CommandBuffer commandBuffer;
+        vk::Semaphore imageAvailable;
+        vk::Fence inFlight;
+        uint64_t ticket = 0;            // presentFromBuffer call last submitted with this frame
+        bool timestampsPending = false;
+    };
+    uint32_t mFramesInFlight = 2;
+    std::vector<FrameSync> mFrames;
+    uint32_t mCurrentFrame = 0;
+    uint64_t mNextTicket = 1;
+
+    std::vector<vk::Semaphore> mRenderFinishedSemaphores; // per swapchain image
+    std::vector<vk::Fence> mImagesInFlight;               // fence of the frame last using each image
+
+    vk::QueryPool mTimestampPool;  // per frame: [2i] before and [2i + 1] after the copy
+    double mTimestampPeriodNs = 0.0;
+    std::vector<double> mCopyTimesMs;
 };
@@ -0,0 +1,257 @@
+/*******************************************************
+* File: async_writer.cpp
+*
+* Description: Asynchronous output sink that hands finished
+* frames to dedicated writer threads so encoding and disk
+* latency stay off the processing loop
+*
+* Author: Logan Schmid
+*
+* Revision history
+*
+********************************************************/
+#include "async_writer.hpp"
+#include "edge_codec.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+AsyncWriter::AsyncWriter(size_t queue_depth) : capacity(queue_depth > 0 ? queue_depth : 1) {}
+
+AsyncWriter::~AsyncWriter() {
+    release();
+}
+
+bool AsyncWriter::open(const string& filename, int fourcc, double fps, Size size, bool isColor) {
+    if (!video.open(filename, fourcc, fps, size, isColor)) {
+        return false;
+    }
+    start(1);
+    return true;
+}
+
+bool AsyncWriter::open_raw(const string& filename) {
+    raw_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (raw_fd < 0) {
+        return false;
+    }
+    start(1);
+    return true;
+}
+
+bool AsyncWriter::open_e442(const string& filename, Size size, double fps, unsigned encoder_threads,
+                            archiveMode_t mode, int threshold) {
+    raw_fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (raw_fd < 0) {
+        return false;
+    }
+    memcpy(archive_header.magic, ARCHIVE_MAGIC, 4);
+    archive_header.version = ARCHIVE_VERSION;
+    archive_header.width = size.width;
+    archive_header.height = size.height;
+    archive_header.fps_milli = static_cast<uint32_t>(fps * 1000.0);
+    archive_header.mode = mode;
+    archive_header.threshold = threshold;
+    if (!write_bytes(&archive_header, sizeof(archive_header))) {
+        close(raw_fd);
+        raw_fd = -1;
+        return false;
+    }
+    file_offset = sizeof(archive_header);
+    e442 = true;
+
+    // keep every encoder busy even if the caller asked for a shallow queue
+    if (capacity < 2 * encoder_threads) {
+        capacity = 2 * encoder_threads;
+    }
+    start(encoder_threads > 0 ? encoder_threads : 1);
+    return true;
+}
+
+bool AsyncWriter::isOpened() const {
+    return !writer_threads.empty();
+}
+
+void AsyncWriter::start(unsigned num_threads) {
+    stopping = false;
+    for (unsigned i = 0; i < num_threads; i++) {
+        writer_threads.emplace_back(&AsyncWriter::writer_loop, this);
+    }
+}
+
+void AsyncWriter::write(const Mat& frame) {
+    unique_lock<mutex> lock(mtx);
+    if (queue.size() + in_flight >= capacity) {
+        // back-pressure: the only place the processing loop waits on disk
+        auto stall_start = chrono::steady_clock::now();
+        not_full.wait(lock, [this] { return queue.size() + in_flight < capacity; });
+        stall_secs += chrono::duration<double>(chrono::steady_clock::now() - stall_start).count();
+        stalls++;
+    }
+    queue.push_back({next_seq++, frame});
+
+    frames_queued++;
+    depth_sum += queue.size();
+    if (queue.size() > max_depth) {
+        max_depth = queue.size();
+    }
+    not_empty.notify_one();
+}
+
+void AsyncWriter::writer_loop() {
+    while (true) {
+        queuedFrame_t job;
+        {
+            unique_lock<mutex> lock(mtx);
+            not_empty.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;  // stopping and fully drained
+            }
+            job = queue.front();
+            queue.pop_front();
+            in_flight++;
+        }
+
+        if (e442) {
+            // compress in parallel, then hand off to be written in order
+            vector<uint8_t> bytes;
+            archive_encode_frame(job.frame.ptr<uint8_t>(0), job.frame.step, archive_header, bytes);
+            commit_encoded(job.seq, bytes);
+        } else {
+            write_frame(job.frame);
+            {
+                lock_guard<mutex> lock(mtx);
+                in_flight--;
+            }
+            not_full.notify_one();
+        }
+    }
+}
+
+void AsyncWriter::commit_encoded(size_t seq, vector<uint8_t>& bytes) {
+    size_t written = 0;
+    {
+        lock_guard<mutex> lock(commit_mtx);
+        reorder[seq].swap(bytes);
+        // whichever encoder finishes the next frame in sequence writes out every ready frame
+        while (!reorder.empty() && reorder.begin()->first == next_commit) {
+            vector<uint8_t>& payload = reorder.begin()->second;
+            uint32_t payload_size = static_cast<uint32_t>(payload.size());
+            // after a failed write the frame is dropped, but still counted so the producer isn't blocked
+            if (!write_failed && write_bytes(&payload_size, sizeof(payload_size)) &&
+                write_bytes(payload.data(), payload.size())) {
+                frame_offsets.push_back(file_offset);
+                file_offset += sizeof(payload_size) + payload.size();
+            }
+            reorder.erase(reorder.begin());
+            next_commit++;
+            written++;
+        }
+    }
+    if (written > 0) {
+        {
+            lock_guard<mutex> lock(mtx);
+            in_flight -= written;
+        }
+        not_full.notify_all();
+    }
+}
+
+bool AsyncWriter::write_bytes(const void* data, size_t size) {
+    const uchar* bytes = static_cast<const uchar*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(raw_fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (!write_failed.exchange(true)) {
+                cerr << "Error: output write failed: " << strerror(errno) << endl;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= written;
+    }
+    return true;
+}
+
+void AsyncWriter::write_frame(const Mat& frame) {
+    if (raw_fd < 0) {
+        video.write(frame);
+        return;
+    }
+    if (write_failed) {
+        return;
+    }
+
+    // raw output: append each row
+    size_t row_bytes = frame.cols * frame.elemSize();
+    for (int row = 0; row < frame.rows; row++) {
+        if (!write_bytes(frame.ptr<uchar>(row), row_bytes)) {
+            return;
+        }
+    }
+}
+
+void AsyncWriter::release() {
+    {
+        lock_guard<mutex> lock(mtx);
+        stopping = true;
+    }
+    not_empty.notify_all();
+    for (thread& writer_thread : writer_threads) {
+        writer_thread.join();
+    }
+    writer_threads.clear();
+    video.release();
+    if (e442 && raw_fd >= 0 && !write_failed) {
+        // index footer so readers can seek to any frame
+        archiveTrailer_t trailer;
+        trailer.index_offset = file_offset;
+        trailer.frame_count = static_cast<uint32_t>(frame_offsets.size());
+        memcpy(trailer.magic, ARCHIVE_INDEX_MAGIC, 4);
+        if (write_bytes(frame_offsets.data(), frame_offsets.size() * sizeof(uint64_t))) {
+            write_bytes(&trailer, sizeof(trailer));
+        }
+    }
+    e442 = false;
+    if (raw_fd >= 0) {
+        if (close(raw_fd) != 0 && !write_failed.exchange(true)) {
+            cerr << "Error: output write failed: " << strerror(errno) << endl;
+        }
+        raw_fd = -1;
+        if (write_failed) {
+            cerr << "Error: output is incomplete, nothing was written after the failed write" << endl;
+        }
+    }
+}
+
+bool AsyncWriter::failed() const {
+    return write_failed;
+}
+
+void AsyncWriter::print_stats() const {
+    // the archive totals belong to whichever encoder is committing, so they need commit_mtx
+    scoped_lock lock(mtx, commit_mtx);
+    double avg_depth = frames_queued ? (double)depth_sum / frames_queued : 0.0;
+    cout << "Writer queue depth: " << capacity
+         << ", max used: " << max_depth
+         << ", avg used: " << avg_depth << endl;
+    cout << "Writer stalls (queue full): " << stalls
+         << ", time stalled: " << stall_secs << " seconds" << endl;
+    if (write_failed) {
+        cout << "Writer: a write failed, the output is incomplete" << endl;
+    }
+    if (!write_failed && file_offset > 0 && next_commit > 0) {
+        double raw_bytes = (double)archive_header.width * archive_header.height * next_commit;
+        cout << "Archive frame data: " << file_offset << " bytes, "
+             << raw_bytes / file_offset << "x smaller than raw frames" << endl;
+    }
+}
@@ -0,0 +1,169 @@
+/*******************************************************
+* File: async_writer.hpp
+*
+* Description: Asynchronous output sink that hands finished
+* frames to dedicated writer threads so encoding and disk
+* latency stay off the processing loop
+*
+* Author: Logan Schmid
+*
+* Revision history
+*
+********************************************************/
+#ifndef _ASYNC_WRITER_HPP
+#define _ASYNC_WRITER_HPP
+
+#include <opencv2/opencv.hpp>
+#include "edge_archive.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class AsyncWriter {
+public:
+    /*-----------------------------------------------------
+    * Function: AsyncWriter
+    *
+    * Description: Creates a closed writer
+    *
+    * param queue_depth: size_t: max frames waiting to be written before
+    * write() blocks
+    *--------------------------------------------------------*/
+    explicit AsyncWriter(size_t queue_depth);
+    ~AsyncWriter();
+
+    /*-----------------------------------------------------
+    * Function: open
+    *
+    * Description: Opens an encoded video output (same args as cv::VideoWriter)
+    *
+    * return: bool: true if the output was opened
+    *--------------------------------------------------------*/
+    bool open(const std::string& filename, int fourcc, double fps, cv::Size size, bool isColor);
+
+    /*-----------------------------------------------------
+    * Function: open_raw
+    *
+    * Description: Opens a raw output where frames are appended
+    * back to back, uncompressed
+    *
+    * param filename: const std::string&: output path
+    *
+    * return: bool: true if the output was opened
+    *--------------------------------------------------------*/
+    bool open_raw(const std::string& filename);
+
+    /*-----------------------------------------------------
+    * Function: open_e442
+    *
+    * Description: Opens a .e442 edge archive (see edge_archive.hpp).
+    * Frames are compressed independently on several encoder threads
+    * and written back in order; the index footer is written by release().
+    *
+    * param filename: const std::string&: output path
+    * param size: cv::Size: frame dims, frames must be 8-bit single channel
+    * param fps: double: frame rate stored in the header
+    * param encoder_threads: unsigned: number of threads compressing frames
+    * param mode: archiveMode_t: lossless, 4-bit quantised or 1-bit mask
+    * param threshold: int: edge cutoff for ARCHIVE_MASK
+    *
+    * return: bool: true if the output was opened
+    *--------------------------------------------------------*/
+    bool open_e442(const std::string& filename, cv::Size size, double fps, unsigned encoder_threads,
+                   archiveMode_t mode, int threshold);
+
+    bool isOpened() const;
+
+    /*-----------------------------------------------------
+    * Function: write
+    *
+    * Description: Queues a frame for the writer thread. Only blocks when
+    * the queue is full. The frame's data is shared, not copied, so the
+    * caller must not modify it afterwards.
+    *
+    * param frame: const cv::Mat&: frame to write
+    *
+    * return: void
+    *--------------------------------------------------------*/
+    void write(const cv::Mat& frame);
+
+    /*-----------------------------------------------------
+    * Function: release
+    *
+    * Description: Writes out every queued frame, stops the writer
+    * thread and closes the output. A .e442 index footer is only
+    * written if every write succeeded.
+    *
+    * return: void
+    *--------------------------------------------------------*/
+    void release();
+
+    /*-----------------------------------------------------
+    * Function: failed
+    *
+    * Description: Whether a write to a raw or .e442 output has failed.
+    * Nothing is written after the first failure, so the file is incomplete.
+    *
+    * return: bool
+    *--------------------------------------------------------*/
+    bool failed() const;
+
+    /*-----------------------------------------------------
+    * Function: print_stats
+    *
+    * Description: Prints queue depth and producer stall statistics
+    *
+    * return: void
+    *--------------------------------------------------------*/
+    void print_stats() const;
+
+private:
+    typedef struct {
+        size_t seq;
+        cv::Mat frame;
+    } queuedFrame_t;
+
+    void start(unsigned num_threads);
+    void writer_loop();
+    void write_frame(const cv::Mat& frame);
+    void commit_encoded(size_t seq, std::vector<uint8_t>& bytes);
+    bool write_bytes(const void* data, size_t size);
+
+    size_t capacity;
+    cv::VideoWriter video;
+    int raw_fd = -1;
+    bool e442 = false;
+    archiveHeader_t archive_header;
+
+    std::vector<std::thread> writer_threads;
+    mutable std::mutex mtx;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::deque<queuedFrame_t> queue;
+    size_t next_seq = 0;
+    size_t in_flight = 0;  // taken off the queue but not yet on disk
+    bool stopping = false;
+    std::atomic<bool> write_failed{false};  // latched by write_bytes, stops all further output
+
+    // encoded frames waiting for their turn to be written, guarded by commit_mtx
+    mutable std::mutex commit_mtx;
+    std::map<size_t, std::vector<uint8_t>> reorder;
+    size_t next_commit = 0;
+    uint64_t file_offset = 0;
+    std::vector<uint64_t> frame_offsets;
+
+    // queue statistics, guarded by mtx
+    size_t frames_queued = 0;
+    size_t depth_sum = 0;
+    size_t max_depth = 0;
+    size_t stalls = 0;
+    double stall_secs = 0.0;
+};
+
+#endif // _ASYNC_WRITER_HPP
@@ -0,0 +1,175 @@
+/*******************************************************
+* File: edge_archive.cpp
+*
+* Description: On-disk .e442 archive of Sobel edge frames
+* with an index footer and a memory-mapped reader
+*
+* Author: Logan Schmid
+*
+* Revision history
+*
+********************************************************/
+#include "edge_archive.hpp"
+#include "edge_codec.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstring>
+
+using namespace std;
+
+// 4-bit levels are expanded back with level * 17 so 15 maps to 255
+#define QUANT4_SHIFT 4
+#define QUANT4_SCALE 17
+
+void archive_encode_frame(const uint8_t* src, size_t stride, const archiveHeader_t& header, vector<uint8_t>& out) {
+    int width = header.width;
+    int height = header.height;
+
+    if (header.mode == ARCHIVE_LOSSLESS) {
+        edge_encode(src, width, height, stride, out);
+        return;
+    }
+
+    if (header.mode == ARCHIVE_QUANT4) {
+        vector<uint8_t> levels(static_cast<size_t>(width) * height);
+        for (int row = 0; row < height; row++) {
+            const uint8_t* src_row = src + row * stride;
+            uint8_t* level_row = levels.data() + static_cast<size_t>(row) * width;
+            for (int col = 0; col < width; col++) {
+                level_row[col] = src_row[col] >> QUANT4_SHIFT;
+            }
+        }
+        edge_encode(levels.data(), width, height, width, out);
+        return;
+    }
+
+    // ARCHIVE_MASK: 8 pixels per byte, MSB first
+    int row_bytes = (width + 7) / 8;
+    vector<uint8_t> bits(static_cast<size_t>(row_bytes) * height, 0);
+    for (int row = 0; row < height; row++) {
+        const uint8_t* src_row = src + row * stride;
+        uint8_t* bit_row = bits.data() + static_cast<size_t>(row) * row_bytes;
+        for (int col = 0; col < width; col++) {
+            if (src_row[col] >= header.threshold) {
+                bit_row[col >> 3] |= 0x80 >> (col & 7);
+            }
+        }
+    }
+    edge_encode(bits.data(), row_bytes, height, row_bytes, out);
+}
+
+EdgeArchiveReader::EdgeArchiveReader() {}
+
+EdgeArchiveReader::~EdgeArchiveReader() {
+    close();
+}
+
+bool EdgeArchiveReader::open(const string& filename) {
+    close();
+
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)(sizeof(archiveHeader_t) + sizeof(archiveTrailer_t))) {
+        ::close(fd);
+        return false;
+    }
+    void* addr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // the mapping keeps the file referenced
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    map = static_cast<const uint8_t*>(addr);
+    map_size = st.st_size;
+
+    hdr = reinterpret_cast<const archiveHeader_t*>(map);
+    archiveTrailer_t trailer;
+    memcpy(&trailer, map + map_size - sizeof(trailer), sizeof(trailer));
+    if (memcmp(hdr->magic, ARCHIVE_MAGIC, 4) != 0 || hdr->version != ARCHIVE_VERSION ||
+        memcmp(trailer.magic, ARCHIVE_INDEX_MAGIC, 4) != 0 ||
+        // the index sits between the frames and the trailer; compare without overflowing
+        trailer.index_offset < sizeof(archiveHeader_t) || trailer.index_offset > map_size - sizeof(trailer) ||
+        trailer.frame_count > (map_size - sizeof(trailer) - trailer.index_offset) / sizeof(uint64_t)) {
+        close();
+        return false;
+    }
+    index = map + trailer.index_offset;
+    count = trailer.frame_count;
+
+    // archives are small, so start paging the whole thing in now
+    madvise(addr, map_size, MADV_WILLNEED);
+    return true;
+}
+
+void EdgeArchiveReader::close() {
+    if (map) {
+        munmap(const_cast<uint8_t*>(map), map_size);
+    }
+    map = nullptr;
+    map_size = 0;
+    hdr = nullptr;
+    index = nullptr;
+    count = 0;
+}
+
+uint32_t EdgeArchiveReader::frame_count() const {
+    return count;
+}
+
+const archiveHeader_t& EdgeArchiveReader::header() const {
+    return *hdr;
+}
+
+bool EdgeArchiveReader::read_frame(uint32_t frame, uint8_t* dst, size_t stride) const {
+    if (frame >= count) {
+        return false;
+    }
+    uint64_t offset;
+    memcpy(&offset, index + (size_t)frame * sizeof(uint64_t), sizeof(offset));
+    uint32_t size;
+    if (offset < sizeof(archiveHeader_t) || offset > map_size - sizeof(size)) {
+        return false;
+    }
+    memcpy(&size, map + offset, sizeof(size));
+    if (size > map_size - sizeof(size) - offset) {
+        return false;
+    }
+    const uint8_t* payload = map + offset + sizeof(size);
+
+    int width = hdr->width;
+    int height = hdr->height;
+    if (hdr->mode == ARCHIVE_LOSSLESS) {
+        return edge_decode(payload, size, dst, width, height, stride);
+    }
+
+    if (hdr->mode == ARCHIVE_QUANT4) {
+        if (!edge_decode(payload, size, dst, width, height, stride)) {
+            return false;
+        }
+        for (int row = 0; row < height; row++) {
+            uint8_t* dst_row = dst + row * stride;
+            for (int col = 0; col < width; col++) {
+                dst_row[col] = dst_row[col] * QUANT4_SCALE;
+            }
+        }
+        return true;
+    }
+
+    int row_bytes = (width + 7) / 8;
+    vector<uint8_t> bits(static_cast<size_t>(row_bytes) * height);
+    if (!edge_decode(payload, size, bits.data(), row_bytes, height, row_bytes)) {
+        return false;
+    }
+    for (int row = 0; row < height; row++) {
+        const uint8_t* bit_row = bits.data() + static_cast<size_t>(row) * row_bytes;
+        uint8_t* dst_row = dst + row * stride;
+        for (int col = 0; col < width; col++) {
+            dst_row[col] = (bit_row[col >> 3] & (0x80 >> (col & 7))) ? 255 : 0;
+        }
+    }
+    return true;
+}
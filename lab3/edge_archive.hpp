@@ -0,0 +1,115 @@
+/*******************************************************
+* File: edge_archive.hpp
+*
+* Description: On-disk .e442 archive of Sobel edge frames.
+*
+*   [archiveHeader_t]
+*   [uint32 size][payload]   x frame_count
+*   [uint64 offset]          x frame_count  (index)
+*   [archiveTrailer_t]
+*
+* Each payload is an edge_encode'd plane, optionally
+* quantised to 4-bit magnitudes or thresholded to a
+* packed 1-bit mask first. The index footer gives O(1)
+* access to any frame of a memory-mapped archive.
+*
+* Author: Logan Schmid
+*
+* Revision history
+*
+********************************************************/
+#ifndef _EDGE_ARCHIVE_HPP
+#define _EDGE_ARCHIVE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#define ARCHIVE_MAGIC "E442"
+#define ARCHIVE_INDEX_MAGIC "E44X"
+#define ARCHIVE_VERSION 2
+
+typedef enum {
+    ARCHIVE_LOSSLESS = 0, // full 8-bit magnitudes
+    ARCHIVE_QUANT4 = 1,   // magnitudes quantised to 16 levels
+    ARCHIVE_MASK = 2      // 1 bit per pixel, set where magnitude >= threshold
+} archiveMode_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps_milli;  // frames per second * 1000
+    uint32_t mode;       // archiveMode_t
+    uint32_t threshold;  // ARCHIVE_MASK cutoff
+} archiveHeader_t;
+
+typedef struct {
+    uint64_t index_offset;
+    uint32_t frame_count;
+    char magic[4];
+} archiveTrailer_t;
+
+/*-----------------------------------------------------
+* Function: archive_encode_frame
+*
+* Description: Quantises (per header.mode) and compresses one 8-bit frame
+* into a frame payload. Safe to call from several threads at once.
+*
+* param src: const uint8_t*: first pixel of the frame
+* param stride: size_t: bytes between the starts of consecutive rows
+* param header: const archiveHeader_t&: archive dims and mode
+* param out: std::vector<uint8_t>&: receives the payload
+*
+* return: void
+*--------------------------------------------------------*/
+void archive_encode_frame(const uint8_t* src, size_t stride,
+                          const archiveHeader_t& header, std::vector<uint8_t>& out);
+
+
+class EdgeArchiveReader {
+public:
+    EdgeArchiveReader();
+    ~EdgeArchiveReader();
+
+    /*-----------------------------------------------------
+    * Function: open
+    *
+    * Description: Memory-maps an archive and validates its header
+    * and index footer
+    *
+    * param filename: const std::string&: archive path
+    *
+    * return: bool: false if the file is missing or malformed
+    *--------------------------------------------------------*/
+    bool open(const std::string& filename);
+    void close();
+
+    uint32_t frame_count() const;
+    const archiveHeader_t& header() const;
+
+    /*-----------------------------------------------------
+    * Function: read_frame
+    *
+    * Description: Decodes any frame straight from the mapping.
+    * Quantised and mask frames are expanded back to 0-255.
+    *
+    * param frame: uint32_t: frame number
+    * param dst: uint8_t*: first pixel of a width x height 8-bit output
+    * param stride: size_t: bytes between the starts of consecutive output rows
+    *
+    * return: bool: false if the index is out of range or the frame is corrupt
+    *--------------------------------------------------------*/
+    bool read_frame(uint32_t frame, uint8_t* dst, size_t stride) const;
+
+private:
+    const uint8_t* map = nullptr;
+    size_t map_size = 0;
+    const archiveHeader_t* hdr = nullptr;
+    const uint8_t* index = nullptr;  // unaligned uint64 offsets
+    uint32_t count = 0;
+};
+
+#endif // _EDGE_ARCHIVE_HPP
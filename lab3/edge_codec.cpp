@@ -0,0 +1,110 @@
+/*******************************************************
+* File: edge_codec.cpp
+*
+* Description: Lightweight lossless codec for 8-bit edge
+* frames: per-row left-neighbour delta followed by
+* PackBits-style run-length encoding of the residuals.
+*
+* Author: Logan Schmid
+*
+* Revision history
+*
+********************************************************/
+#include "edge_codec.hpp"
+
+using namespace std;
+
+// Control byte layout:
+//   0..127   -> literal, the next (c + 1) bytes are copied as-is
+//   128..255 -> run, the next byte is repeated (c - RUN_BIAS) times
+#define MAX_LITERAL 128
+#define MIN_RUN 3
+#define MAX_RUN 130
+#define RUN_BIAS (128 - MIN_RUN)
+
+void edge_encode(const uint8_t* src, int width, int height, size_t stride, vector<uint8_t>& out) {
+    size_t n = static_cast<size_t>(width) * height;
+
+    // left-neighbour delta; flat regions and the zero background become runs of 0
+    vector<uint8_t> residual(n);
+    for (int row = 0; row < height; row++) {
+        const uint8_t* src_row = src + row * stride;
+        uint8_t* res_row = residual.data() + static_cast<size_t>(row) * width;
+        uint8_t prev = 0;
+        for (int col = 0; col < width; col++) {
+            res_row[col] = static_cast<uint8_t>(src_row[col] - prev);
+            prev = src_row[col];
+        }
+    }
+
+    out.clear();
+    out.reserve(n / 8);
+    size_t i = 0;
+    while (i < n) {
+        size_t run = 1;
+        while (i + run < n && run < MAX_RUN && residual[i + run] == residual[i]) {
+            run++;
+        }
+        if (run >= MIN_RUN) {
+            out.push_back(static_cast<uint8_t>(run + RUN_BIAS));
+            out.push_back(residual[i]);
+            i += run;
+            continue;
+        }
+
+        // literal until the next run of MIN_RUN equal bytes starts
+        size_t start = i;
+        while (i < n && i - start < MAX_LITERAL) {
+            if (i + 2 < n && residual[i] == residual[i + 1] && residual[i] == residual[i + 2]) {
+                break;
+            }
+            i++;
+        }
+        out.push_back(static_cast<uint8_t>(i - start - 1));
+        out.insert(out.end(), residual.begin() + start, residual.begin() + i);
+    }
+}
+
+bool edge_decode(const uint8_t* data, size_t size, uint8_t* dst, int width, int height, size_t stride) {
+    size_t n = static_cast<size_t>(width) * height;
+    vector<uint8_t> residual(n);
+
+    size_t pos = 0;
+    size_t filled = 0;
+    while (pos < size && filled < n) {
+        uint8_t control = data[pos++];
+        if (control >= 128) {
+            size_t run = control - RUN_BIAS;
+            if (pos >= size || filled + run > n) {
+                return false;
+            }
+            uint8_t value = data[pos++];
+            for (size_t k = 0; k < run; k++) {
+                residual[filled++] = value;
+            }
+        } else {
+            size_t len = control + 1;
+            if (pos + len > size || filled + len > n) {
+                return false;
+            }
+            for (size_t k = 0; k < len; k++) {
+                residual[filled++] = data[pos++];
+            }
+        }
+    }
+    if (filled != n) {
+        return false;
+    }
+
+    // undo the delta
+    for (int row = 0; row < height; row++) {
+        const uint8_t* res_row = residual.data() + static_cast<size_t>(row) * width;
+        uint8_t* dst_row = dst + row * stride;
+        uint8_t prev = 0;
+        for (int col = 0; col < width; col++) {
+            prev = static_cast<uint8_t>(prev + res_row[col]);
+            dst_row[col] = prev;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,56 @@
+/*******************************************************
+* File: edge_codec.hpp
+*
+* Description: Lightweight lossless codec for 8-bit edge
+* frames: per-row left-neighbour delta followed by
+* PackBits-style run-length encoding of the residuals.
+* Every frame is encoded independently so frames can be
+* compressed on several threads at once.
+*
+* Author: Logan Schmid
+*
+* Revision history
+*
+********************************************************/
+#ifndef _EDGE_CODEC_HPP
+#define _EDGE_CODEC_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*-----------------------------------------------------
+* Function: edge_encode
+*
+* Description: Losslessly compresses one 8-bit single channel frame
+*
+* param src: const uint8_t*: first pixel of the frame
+* param width: int: frame width in pixels
+* param height: int: frame height in pixels
+* param stride: size_t: bytes between the starts of consecutive rows
+* param out: std::vector<uint8_t>&: receives the compressed bytes
+*
+* return: void
+*--------------------------------------------------------*/
+void edge_encode(const uint8_t* src, int width, int height, size_t stride,
+                 std::vector<uint8_t>& out);
+
+
+/*-----------------------------------------------------
+* Function: edge_decode
+*
+* Description: Decompresses a frame produced by edge_encode
+*
+* param data: const uint8_t*: compressed bytes
+* param size: size_t: number of compressed bytes
+* param dst: uint8_t*: first pixel of the output frame
+* param width: int: frame width in pixels
+* param height: int: frame height in pixels
+* param stride: size_t: bytes between the starts of consecutive output rows
+*
+* return: bool: false if the data is truncated or doesn't match the dims
+*--------------------------------------------------------*/
+bool edge_decode(const uint8_t* data, size_t size, uint8_t* dst,
+                 int width, int height, size_t stride);
+
+#endif // _EDGE_CODEC_HPP
@@ -11,29 +11,40 @@
 #include <opencv2/opencv.hpp>
 #include <iostream>
 #include "processing.hpp"
+#include "async_writer.hpp"
+#include "frame_source.hpp"
 #include <filesystem>
 #include <chrono>
 
+// frames allowed to wait for the writer thread before processing blocks
+#define WRITER_QUEUE_DEPTH 8
+
+// Sobel magnitude at or above which a pixel is set in "e442-mask" archives
+#define MASK_THRESHOLD 64
+
 using namespace cv;
 using namespace std;
 namespace fs = std::filesystem;
 
 int main(int argc, char** argv) {
    auto start = chrono::high_resolution_clock::now();
-	if (argc != 3) {
-        cerr << "Incorrect usage - use via: 'edge_detector [video_path] [sobel_option = {\"442\"/\"cv\"}]" << endl;
+	if (argc != 3 && argc != 4) {
+        cerr << "Incorrect usage - use via: 'edge_detector [video_path|synth:WxH[@fps][:gradient|noise|edges|mix[:frames]]] [sobel_option = {\"442\"/\"cv\"}] [output_format = {\"mp4\"/\"raw\"/\"e442\"/\"e442-q4\"/\"e442-mask\"}]" << endl;
         return -1;
     }
 
     string cap_path = argv[1];
     string sobel_option = argv[2];
+    string output_format = (argc == 4) ? argv[3] : "mp4";
+    if (output_format != "mp4" && output_format != "raw" && output_format != "e442" &&
+        output_format != "e442-q4" && output_format != "e442-mask") {
+        cerr << "Error: output_format command-line arg must be \"mp4\", \"raw\", \"e442\", \"e442-q4\" or \"e442-mask\"" << endl;
+        return -1;
+    }
 
-    fs::path input_path(cap_path);
-    string base_name = input_path.filename().string();
-
-    // Initialize video reader
-    VideoCapture cap(cap_path);
-    if (!cap.isOpened()) {
+    // Initialize video reader, or the synthetic source for a synth: spec (lab6/frame_source.hpp)
+    frameSource_t cap;
+    if (!source_open(&cap, cap_path)) {
         cerr << "Error: Could not open video file: " << cap_path << endl;
         return -1;
     } else {
@@ -41,13 +52,17 @@ int main(int argc, char** argv) {
     }
 
     // get and print video attributes
-    int frame_count = static_cast<int>(cap.get(CAP_PROP_FRAME_COUNT));
-    double fps = cap.get(CAP_PROP_FPS);
-    int width = static_cast<int>(cap.get(CAP_PROP_FRAME_WIDTH));
-    int height = static_cast<int>(cap.get(CAP_PROP_FRAME_HEIGHT));    
+    int frame_count = static_cast<int>(source_get(&cap, CAP_PROP_FRAME_COUNT));
+    double fps = source_get(&cap, CAP_PROP_FPS);
+    int width = static_cast<int>(source_get(&cap, CAP_PROP_FRAME_WIDTH));
+    int height = static_cast<int>(source_get(&cap, CAP_PROP_FRAME_HEIGHT));    
     cout << "Total frames: " << frame_count << ", FPS: " << fps << endl;
     cout << "Width: " << width << ", Height: " << height << endl;
 
+    // a synth: spec isn't a usable file name, so name its outputs after the frame size
+    string base_name = cap.synthetic ? "synth_" + to_string(width) + "x" + to_string(height) + ".mp4"
+                                     : fs::path(cap_path).filename().string();
+
     // Initialize video writer
     string out_filename;
     Size out_size;
@@ -58,9 +73,31 @@ int main(int argc, char** argv) {
         out_filename = "cv_sobel_" + base_name;
         out_size = Size(width, height);
     }
-    int codec = VideoWriter::fourcc('m', 'p', '4', 'v');
-    bool isColor = false;
-    VideoWriter writer(out_filename, codec, fps, out_size, isColor);
+    // frames are encoded/written on a separate thread, see async_writer.cpp
+    AsyncWriter writer(WRITER_QUEUE_DEPTH);
+    if (output_format == "raw") {
+        out_filename = fs::path(out_filename).replace_extension(".gray").string();
+        writer.open_raw(out_filename);
+        cout << "Writing raw 8-bit gray frames of " << out_size.width << "x" << out_size.height
+             << " to " << out_filename << endl;
+    } else if (output_format.rfind("e442", 0) == 0) {
+        // indexed edge archive, frames compressed on every core in parallel
+        archiveMode_t mode = ARCHIVE_LOSSLESS;
+        if (output_format == "e442-q4") {
+            mode = ARCHIVE_QUANT4;
+        } else if (output_format == "e442-mask") {
+            mode = ARCHIVE_MASK;
+        }
+        unsigned encoder_threads = max(1u, thread::hardware_concurrency());
+        out_filename = fs::path(out_filename).replace_extension(".e442").string();
+        writer.open_e442(out_filename, out_size, fps, encoder_threads, mode, MASK_THRESHOLD);
+        cout << "Writing edge archive to " << out_filename
+             << " with " << encoder_threads << " encoder threads" << endl;
+    } else {
+        int codec = VideoWriter::fourcc('m', 'p', '4', 'v');
+        bool isColor = false;
+        writer.open(out_filename, codec, fps, out_size, isColor);
+    }
     if (!writer.isOpened()) {
         cerr << "Could not open the output video file for write" << endl;
         return -1;
@@ -69,7 +106,7 @@ int main(int argc, char** argv) {
     // Read, save, and display each frame of the video
     while (true) {
         Mat frame;
-        bool ret = cap.read(frame);
+        bool ret = source_read(&cap, frame);
         if (!ret) {
             cout << "End of video or error occurred." << endl;
             break;
@@ -89,7 +126,7 @@ int main(int argc, char** argv) {
             return -1;
         }
 
-        // write filtered frame
+        // queue filtered frame for the writer thread
         writer.write(frame_sobel);
         
         // Display the frame
@@ -104,7 +141,7 @@ int main(int argc, char** argv) {
     }
 
     // Release the video capture object and close any OpenCV windows
-    cap.release();
+    source_release(&cap);
     writer.release();
     destroyAllWindows();
 
@@ -112,6 +149,8 @@ int main(int argc, char** argv) {
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
     float duration_secs = (float)duration.count()/1000;
     cout << "Averate FPS: " << frame_count / duration_secs << endl;
+    writer.print_stats();
 
-    return 0;
+    // a failed write leaves a truncated output, so don't report success
+    return writer.failed() ? -1 : 0;
 }
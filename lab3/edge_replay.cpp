@@ -0,0 +1,63 @@
+/*********************************************************
+* File: edge_replay.cpp
+*
+* Description: Replays a .e442 edge archive written by
+* edge_detector, seeking straight to any starting frame
+* through the archive's index footer
+*
+* Authors: Logan Schmid
+*
+* Revisions:
+*
+**********************************************************/
+#include <opencv2/opencv.hpp>
+#include <iostream>
+#include <chrono>
+#include "edge_archive.hpp"
+
+using namespace cv;
+using namespace std;
+
+int main(int argc, char** argv) {
+    if (argc != 2 && argc != 3) {
+        cerr << "Incorrect usage - use via: 'edge_replay [archive_path] [start_frame = 0]'" << endl;
+        return -1;
+    }
+
+    EdgeArchiveReader archive;
+    if (!archive.open(argv[1])) {
+        cerr << "Error: Could not open edge archive: " << argv[1] << endl;
+        return -1;
+    }
+    const archiveHeader_t& header = archive.header();
+    uint32_t start_frame = (argc == 3) ? static_cast<uint32_t>(atoi(argv[2])) : 0;
+    double fps = header.fps_milli / 1000.0;
+    cout << "Frames: " << archive.frame_count() << ", FPS: " << fps
+         << ", Width: " << header.width << ", Height: " << header.height
+         << ", Mode: " << header.mode << endl;
+
+    Mat frame(header.height, header.width, CV_8UC1);
+    double decode_secs = 0.0;
+    uint32_t frames_decoded = 0;
+    for (uint32_t i = start_frame; i < archive.frame_count(); i++) {
+        auto decode_start = chrono::steady_clock::now();
+        if (!archive.read_frame(i, frame.data, frame.step)) {
+            cerr << "Error: frame " << i << " is corrupt" << endl;
+            return 1;
+        }
+        decode_secs += chrono::duration<double>(chrono::steady_clock::now() - decode_start).count();
+        frames_decoded++;
+
+        imshow("Replay Window", frame);
+        char key = waitKey(fps > 0 ? static_cast<int>(1000 / fps) : 1);
+        if (key == 'q') {
+            break;
+        }
+    }
+    destroyAllWindows();
+
+    if (frames_decoded > 0) {
+        cout << "Avg decode time: " << 1000.0 * decode_secs / frames_decoded << " ms/frame" << endl;
+    }
+    return 0;
+}
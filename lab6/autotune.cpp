@@ -0,0 +1,288 @@
+/*******************************************************
+* File: autotune.cpp
+*
+* Description: Benchmarks worker counts and kernel variants
+* on synthetic frames and caches the fastest per host
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#include <opencv2/opencv.hpp>
+#include "autotune.hpp"
+#include "processing.hpp"
+#include "frame_source.hpp"
+#include <pthread.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+#define TUNE_MIN_FRAMES 5 // per candidate, however small the budget
+#define TUNE_MAX_FRAMES 200
+
+static const int strip_candidates[] = {0, 8, 16, 32, 64};
+
+typedef struct {
+    threadArgs_t band;
+    int strip_rows;
+    pthread_barrier_t* barrier;
+    const bool* running;
+} benchWorker_t;
+
+/*-----------------------------------------------------
+* Function: read_cpu_model
+*
+* Description: Reads the CPU model from /proc/cpuinfo: "model name"
+* on x86, "Model" on a Raspberry Pi, otherwise the ARM "CPU part"
+*
+* return: string: the model, or "unknown"
+*--------------------------------------------------------*/
+static string read_cpu_model() {
+    const char* fields[] = {"model name", "Model", "CPU part"};
+    ifstream cpuinfo("/proc/cpuinfo");
+    string line;
+    string found[3];
+    while (getline(cpuinfo, line)) {
+        size_t colon = line.find(':');
+        if (colon == string::npos) {
+            continue;
+        }
+        string name = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+        for (int i = 0; i < 3; i++) {
+            if (name == fields[i] && found[i].empty() && colon + 2 <= line.size()) {
+                found[i] = line.substr(colon + 2);
+            }
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        if (!found[i].empty()) {
+            return found[i];
+        }
+    }
+    return "unknown";
+}
+
+string tune_cache_key(const vector<cpuInfo_t>& cpus, int width, int height) {
+    string key = read_cpu_model() + " x" + to_string(cpus.size()) + " " +
+                 to_string(width) + "x" + to_string(height);
+    replace(key.begin(), key.end(), '\t', ' ');
+    return key;
+}
+
+string tune_default_cache_path() {
+    const char* xdg = getenv("XDG_CACHE_HOME");
+    if (xdg != NULL && xdg[0] != '\0') {
+        return string(xdg) + "/edge_detector_tune.txt";
+    }
+    const char* home = getenv("HOME");
+    if (home != NULL && home[0] != '\0') {
+        return string(home) + "/.cache/edge_detector_tune.txt";
+    }
+    return "edge_detector_tune.txt";
+}
+
+bool tune_cache_load(const string& path, const string& key, tuneConfig_t* config) {
+    ifstream file(path);
+    string line;
+    bool found = false;
+    while (getline(file, line)) {
+        size_t tab = line.rfind('\t');
+        if (tab == string::npos || line.compare(0, tab, key) != 0 || tab != key.size()) {
+            continue;
+        }
+        tuneConfig_t entry;
+        stringstream values(line.substr(tab + 1));
+        if (values >> entry.threads >> entry.strip_rows && entry.threads > 0 && entry.strip_rows >= 0) {
+            *config = entry; // the last entry for a key wins
+            found = true;
+        }
+    }
+    return found;
+}
+
+bool tune_cache_save(const string& path, const string& key, const tuneConfig_t& config) {
+    // keep every other host's and resolution's entries
+    vector<string> lines;
+    {
+        ifstream file(path);
+        string line;
+        while (getline(file, line)) {
+            if (line.compare(0, key.size() + 1, key + "\t") != 0) {
+                lines.push_back(line);
+            }
+        }
+    }
+    lines.push_back(key + "\t" + to_string(config.threads) + " " + to_string(config.strip_rows));
+
+    size_t slash = path.rfind('/');
+    if (slash != string::npos && slash > 0) {
+        mkdir(path.substr(0, slash).c_str(), 0755); // ~/.cache may not exist yet
+    }
+    // write a temporary file and rename it so a concurrent run never reads half a file
+    string tmp = path + ".tmp";
+    {
+        ofstream file(tmp);
+        for (const string& line : lines) {
+            file << line << "\n";
+        }
+        if (!file) {
+            return false;
+        }
+    }
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+/*-----------------------------------------------------
+* Function: bench_worker
+*
+* Description: Benchmark worker, following the same three barriers
+* per frame as process_quadrant
+*
+* param arg: void*: the worker's benchWorker_t
+*
+* return: void*
+*--------------------------------------------------------*/
+static void* bench_worker(void* arg) {
+    benchWorker_t* worker = static_cast<benchWorker_t*>(arg);
+    threadArgs_t* band = &worker->band;
+    Mat strip_gray;
+    int pin_err = pin_thread_to_cpus(pthread_self(), vector<int>{band->cpu});
+    if (pin_err != 0) {
+        fprintf(stderr, "Autotune: couldn't pin worker %d to CPU %d: %s\n", band->thread_id, band->cpu, strerror(pin_err));
+    }
+    while (true) {
+        pthread_barrier_wait(worker->barrier);
+        if (!*worker->running) {
+            return NULL;
+        }
+        if (worker->strip_rows > 0) {
+            to442_edge_strips(band->src, &strip_gray, band->sobel, band->row_0, band->col_0, band->h, band->w, worker->strip_rows);
+        } else {
+            to442_grayscale(band->src, band->gray, band->row_0, band->col_0, band->h, band->w);
+        }
+        pthread_barrier_wait(worker->barrier);
+        if (worker->strip_rows == 0) {
+            to442_sobel(band->gray, band->sobel, band->row_0, band->col_0, band->h, band->w);
+        }
+        pthread_barrier_wait(worker->barrier);
+    }
+}
+
+/*-----------------------------------------------------
+* Function: time_candidate
+*
+* Description: Runs one configuration for its share of the budget
+*
+* param config: const tuneConfig_t&: candidate
+* param frame, gray, sobel: Mat&: synthetic frame and its stages
+* param cpus: const vector<cpuInfo_t>&: topology
+* param budget_ms: double: time to spend
+*
+* return: double: median frame time in milliseconds
+*--------------------------------------------------------*/
+static double time_candidate(const tuneConfig_t& config, Mat& frame, Mat& gray, Mat& sobel,
+                             const vector<cpuInfo_t>& cpus, double budget_ms) {
+    int node = 0;
+    vector<cpuInfo_t> placement = pick_worker_cpus(cpus, config.threads, &node);
+    vector<benchWorker_t> workers(config.threads);
+    vector<threadArgs_t> bands(config.threads);
+    vector<pthread_t> threads(config.threads);
+    to442_split_rows(bands.data(), config.threads, &frame, &gray, &sobel);
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, config.threads + 1);
+    bool running = true;
+    for (int i = 0; i < config.threads; i++) {
+        workers[i].band = bands[i];
+        workers[i].band.cpu = placement[i].cpu;
+        workers[i].strip_rows = config.strip_rows;
+        workers[i].barrier = &barrier;
+        workers[i].running = &running;
+        if (pthread_create(&threads[i], NULL, bench_worker, &workers[i]) != 0) {
+            fprintf(stderr, "Autotune: pthread_create #%d failed\n", i);
+            abort();
+        }
+    }
+
+    // the first frame warms the caches and isn't counted
+    vector<double> times;
+    auto start = chrono::steady_clock::now();
+    for (int f = 0; f <= TUNE_MAX_FRAMES; f++) {
+        auto t0 = chrono::steady_clock::now();
+        pthread_barrier_wait(&barrier);
+        pthread_barrier_wait(&barrier);
+        pthread_barrier_wait(&barrier);
+        auto t1 = chrono::steady_clock::now();
+        if (f > 0) {
+            times.push_back(chrono::duration<double, milli>(t1 - t0).count());
+        }
+        double elapsed = chrono::duration<double, milli>(t1 - start).count();
+        if ((int)times.size() >= TUNE_MIN_FRAMES && elapsed >= budget_ms) {
+            break;
+        }
+    }
+
+    running = false;
+    pthread_barrier_wait(&barrier);
+    for (int i = 0; i < config.threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+
+    sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+tuneConfig_t tune_benchmark(const vector<cpuInfo_t>& cpus, int width, int height, int budget_ms) {
+    // the same frame as the first of synth:WxH, so results repeat from run to run
+    frameSource_t source;
+    Mat frame;
+    source_open(&source, "synth:" + to_string(width) + "x" + to_string(height) + ":mix");
+    source_read(&source, frame);
+    source_release(&source);
+    Mat gray(height, width, CV_8UC1);
+    Mat sobel(height-2, width-2, CV_8UC1);
+
+    int max_threads = max(min((int)cpus.size(), height / 2), 1); // the driver's limit for this height
+    vector<int> thread_candidates;
+    for (int n = 1; n < max_threads; n *= 2) {
+        thread_candidates.push_back(n);
+    }
+    int num_strips = sizeof(strip_candidates) / sizeof(strip_candidates[0]);
+    double share_ms = (double)budget_ms / (num_strips + thread_candidates.size());
+
+    // kernel variant first, with every CPU busy as in a real run
+    tuneConfig_t best = {max_threads, 0};
+    double best_ms = 0;
+    for (int i = 0; i < num_strips; i++) {
+        tuneConfig_t candidate = {max_threads, strip_candidates[i]};
+        double ms = time_candidate(candidate, frame, gray, sobel, cpus, share_ms);
+        cout << "Autotune: " << candidate.threads << " threads, strips " << candidate.strip_rows << ": " << ms << " ms" << endl;
+        if (i == 0 || ms < best_ms) {
+            best = candidate;
+            best_ms = ms;
+        }
+    }
+
+    // then fewer workers with that variant, which wins when memory bandwidth is the limit
+    for (int n : thread_candidates) {
+        tuneConfig_t candidate = {n, best.strip_rows};
+        double ms = time_candidate(candidate, frame, gray, sobel, cpus, share_ms);
+        cout << "Autotune: " << candidate.threads << " threads, strips " << candidate.strip_rows << ": " << ms << " ms" << endl;
+        if (ms < best_ms) {
+            best = candidate;
+            best_ms = ms;
+        }
+    }
+    return best;
+}
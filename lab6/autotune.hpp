@@ -0,0 +1,96 @@
+/*******************************************************
+* File: autotune.hpp
+*
+* Description: Startup autotuner for the worker count and
+* kernel variant. Candidates are timed on synthetic frames
+* and the winner is cached per CPU model and resolution
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#ifndef _AUTOTUNE_HPP
+#define _AUTOTUNE_HPP
+
+#include <string>
+#include <vector>
+#include "topology.hpp"
+
+typedef struct {
+    int threads;    // worker threads
+    int strip_rows; // 0: grayscale the whole band, barrier, then Sobel; > 0: to442_edge_strips
+} tuneConfig_t;
+
+/*-----------------------------------------------------
+* Function: tune_cache_key
+*
+* Description: Identifies the host and resolution a tuning result
+* is valid for: CPU model, usable CPU count and frame size
+*
+* param cpus: const std::vector<cpuInfo_t>&: topology from read_cpu_topology
+* param width: int: frame width
+* param height: int: frame height
+*
+* return: std::string: a key without tabs or newlines
+*--------------------------------------------------------*/
+std::string tune_cache_key(const std::vector<cpuInfo_t>& cpus, int width, int height);
+
+
+/*-----------------------------------------------------
+* Function: tune_default_cache_path
+*
+* Description: $XDG_CACHE_HOME/edge_detector_tune.txt, falling back
+* to ~/.cache, then the working directory
+*
+* return: std::string
+*--------------------------------------------------------*/
+std::string tune_default_cache_path();
+
+
+/*-----------------------------------------------------
+* Function: tune_cache_load
+*
+* Description: Looks up a cached result
+*
+* param path: const std::string&: cache file
+* param key: const std::string&: from tune_cache_key
+* param config: tuneConfig_t*: output
+*
+* return: bool: false if there's no usable entry for the key
+*--------------------------------------------------------*/
+bool tune_cache_load(const std::string& path, const std::string& key, tuneConfig_t* config);
+
+
+/*-----------------------------------------------------
+* Function: tune_cache_save
+*
+* Description: Stores a result, replacing any entry for the same key
+*
+* param path: const std::string&: cache file
+* param key: const std::string&: from tune_cache_key
+* param config: const tuneConfig_t&
+*
+* return: bool: false if the file couldn't be written
+*--------------------------------------------------------*/
+bool tune_cache_save(const std::string& path, const std::string& key, const tuneConfig_t& config);
+
+
+/*-----------------------------------------------------
+* Function: tune_benchmark
+*
+* Description: Times the kernel variants with every CPU busy, then
+* worker counts with the fastest variant, on a synthetic frame of the
+* given size. Each candidate gets an equal share of the budget, but
+* at least a few frames.
+*
+* param cpus: const std::vector<cpuInfo_t>&: topology from read_cpu_topology
+* param width: int: frame width
+* param height: int: frame height
+* param budget_ms: int: total time to spend
+*
+* return: tuneConfig_t: the candidate with the lowest median frame time
+*--------------------------------------------------------*/
+tuneConfig_t tune_benchmark(const std::vector<cpuInfo_t>& cpus, int width, int height, int budget_ms);
+
+#endif // _AUTOTUNE_HPP
@@ -0,0 +1,268 @@
+/*******************************************************
+* File: counters.cpp
+*
+* Description: PAPI and perf_event_open backends for the
+* per-thread hardware counters
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#include "counters.hpp"
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+#ifdef HAVE_PAPI
+extern "C" {
+	#include <papi.h>
+}
+
+static const int papi_events[COUNTER_EVENTS] = {
+    PAPI_L1_DCM, PAPI_L1_ICM, PAPI_L2_DCM, PAPI_TOT_CYC, PAPI_BR_MSP, PAPI_TOT_INS
+};
+#endif
+
+using namespace std;
+
+typedef struct {
+    uint32_t type;
+    uint64_t config;
+} perfEvent_t;
+
+#define HW_CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+// The kernel has no generic L2 event; the last-level cache is L2 on the Pi's Cortex-A72
+static const perfEvent_t perf_events[COUNTER_EVENTS] = {
+    {PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    {PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_L1I)},
+    {PERF_TYPE_HW_CACHE, HW_CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS}
+};
+
+static counterBackend_t backend = COUNTERS_NONE;
+
+/*-----------------------------------------------------
+* Function: perf_open
+*
+* Description: Opens one user-space event counting the calling thread
+* on whichever CPU it runs
+*
+* param event: const perfEvent_t&: event to count
+* param group_fd: int: group leader, or -1 to open a new (disabled) leader
+*
+* return: int: the event's fd, -1 on failure
+*--------------------------------------------------------*/
+static int perf_open(const perfEvent_t& event, int group_fd) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    attr.disabled = (group_fd == -1) ? 1 : 0; // members follow their leader
+    attr.exclude_kernel = 1; // allowed at perf_event_paranoid <= 2, the distro default
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+#ifdef HAVE_PAPI
+/*-----------------------------------------------------
+* Function: papi_usable
+*
+* Description: Initializes PAPI with thread support and checks it
+* has a cycle counter preset, so hosts with the library but no PMU
+* support fall through to perf
+*
+* return: bool
+*--------------------------------------------------------*/
+static bool papi_usable() {
+    int retval = PAPI_library_init(PAPI_VER_CURRENT);
+    if (retval != PAPI_VER_CURRENT) {
+        cerr << "PAPI unavailable: " << PAPI_strerror(retval) << endl;
+        return false;
+    }
+    retval = PAPI_thread_init(pthread_self);
+    if (retval != PAPI_OK) {
+        cerr << "PAPI thread support unavailable: " << PAPI_strerror(retval) << endl;
+        return false;
+    }
+    return PAPI_query_event(PAPI_TOT_CYC) == PAPI_OK;
+}
+#endif
+
+/*-----------------------------------------------------
+* Function: perf_usable
+*
+* Description: Checks the kernel lets this process count its own cycles
+*
+* return: bool
+*--------------------------------------------------------*/
+static bool perf_usable() {
+    int fd = perf_open(perf_events[COUNTER_TOT_CYC], -1);
+    if (fd < 0) {
+        cerr << "perf_event_open unavailable: " << strerror(errno) << endl;
+        return false;
+    }
+    close(fd);
+    return true;
+}
+
+bool counters_valid_request(const char* requested) {
+    const char* names[] = {"auto", "papi", "perf", "none"};
+    for (const char* name : names) {
+        if (strcmp(requested, name) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+counterBackend_t counters_init(const char* requested) {
+    bool any = strcmp(requested, "auto") == 0;
+#ifdef HAVE_PAPI
+    if ((any || strcmp(requested, "papi") == 0) && papi_usable()) {
+        backend = COUNTERS_PAPI;
+        return backend;
+    }
+#else
+    if (strcmp(requested, "papi") == 0) {
+        cerr << "Built without PAPI" << endl;
+    }
+#endif
+    if ((any || strcmp(requested, "perf") == 0) && perf_usable()) {
+        backend = COUNTERS_PERF;
+        return backend;
+    }
+    backend = COUNTERS_NONE;
+    return backend;
+}
+
+const char* counters_backend_name(counterBackend_t which) {
+    switch (which) {
+        case COUNTERS_PAPI: return "PAPI";
+        case COUNTERS_PERF: return "perf_event_open";
+        default: return "none";
+    }
+}
+
+void counters_thread_start(counterSet_t* set) {
+    set->backend = backend;
+    for (int i = 0; i < COUNTER_EVENTS; i++) {
+        set->papi_slot[i] = -1;
+        set->perf_fd[i] = -1;
+    }
+
+#ifdef HAVE_PAPI
+    if (backend == COUNTERS_PAPI) {
+        set->papi_event_set = PAPI_NULL;
+        if (PAPI_create_eventset(&set->papi_event_set) != PAPI_OK) {
+            set->backend = COUNTERS_NONE;
+            return;
+        }
+        // presets the hardware can't count (or can't count together) are left out
+        int added = 0;
+        for (int i = 0; i < COUNTER_EVENTS; i++) {
+            if (PAPI_add_event(set->papi_event_set, papi_events[i]) == PAPI_OK) {
+                set->papi_slot[i] = added++;
+            }
+        }
+        if (added == 0 || PAPI_start(set->papi_event_set) != PAPI_OK) {
+            PAPI_cleanup_eventset(set->papi_event_set);
+            PAPI_destroy_eventset(&set->papi_event_set);
+            set->backend = COUNTERS_NONE;
+        }
+        return;
+    }
+#endif
+
+    if (backend == COUNTERS_PERF) {
+        // cycles lead the group, the rest join it
+        int leader = perf_open(perf_events[COUNTER_TOT_CYC], -1);
+        if (leader < 0) {
+            set->backend = COUNTERS_NONE;
+            return;
+        }
+        set->perf_fd[COUNTER_TOT_CYC] = leader;
+        for (int i = 0; i < COUNTER_EVENTS; i++) {
+            if (i != COUNTER_TOT_CYC) {
+                set->perf_fd[i] = perf_open(perf_events[i], leader);
+            }
+        }
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void counters_thread_read(counterSet_t* set, long long* values) {
+    for (int i = 0; i < COUNTER_EVENTS; i++) {
+        values[i] = COUNTER_UNAVAILABLE;
+    }
+
+#ifdef HAVE_PAPI
+    if (set->backend == COUNTERS_PAPI) {
+        long long papi_values[COUNTER_EVENTS];
+        if (PAPI_read(set->papi_event_set, papi_values) == PAPI_OK) {
+            for (int i = 0; i < COUNTER_EVENTS; i++) {
+                if (set->papi_slot[i] >= 0) {
+                    values[i] = papi_values[set->papi_slot[i]];
+                }
+            }
+        }
+        return;
+    }
+#endif
+
+    if (set->backend == COUNTERS_PERF) {
+        for (int i = 0; i < COUNTER_EVENTS; i++) {
+            uint64_t reading[3]; // value, time enabled, time running
+            if (set->perf_fd[i] >= 0 &&
+                read(set->perf_fd[i], reading, sizeof(reading)) == (ssize_t)sizeof(reading) && reading[2] > 0) {
+                // scale up if the kernel had to multiplex the group with other users of the PMU
+                values[i] = (long long)((double)reading[0] * reading[1] / reading[2]);
+            }
+        }
+    }
+}
+
+void counters_thread_stop(counterSet_t* set, long long* values) {
+#ifdef HAVE_PAPI
+    if (set->backend == COUNTERS_PAPI) {
+        for (int i = 0; i < COUNTER_EVENTS; i++) {
+            values[i] = COUNTER_UNAVAILABLE;
+        }
+        long long papi_values[COUNTER_EVENTS];
+        if (PAPI_stop(set->papi_event_set, papi_values) == PAPI_OK) {
+            for (int i = 0; i < COUNTER_EVENTS; i++) {
+                if (set->papi_slot[i] >= 0) {
+                    values[i] = papi_values[set->papi_slot[i]];
+                }
+            }
+        }
+        PAPI_cleanup_eventset(set->papi_event_set);
+        PAPI_destroy_eventset(&set->papi_event_set);
+        return;
+    }
+#endif
+
+    if (set->backend == COUNTERS_PERF) {
+        ioctl(set->perf_fd[COUNTER_TOT_CYC], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+    counters_thread_read(set, values);
+    for (int i = 0; i < COUNTER_EVENTS; i++) {
+        if (set->perf_fd[i] >= 0) {
+            close(set->perf_fd[i]);
+            set->perf_fd[i] = -1;
+        }
+    }
+}
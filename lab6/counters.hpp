@@ -0,0 +1,123 @@
+/*******************************************************
+* File: counters.hpp
+*
+* Description: Per-thread hardware performance counters,
+* read through PAPI when it is built in and usable, or
+* directly through the Linux perf_event_open syscall
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#ifndef _COUNTERS_HPP
+#define _COUNTERS_HPP
+
+// Counted events, in the order of the counter fields in threadArgs_t
+#define COUNTER_L1_DCM 0   // L1 data cache misses
+#define COUNTER_L1_ICM 1   // L1 instruction cache misses
+#define COUNTER_L2_DCM 2   // L2 data cache misses (last-level cache misses under perf)
+#define COUNTER_TOT_CYC 3  // cycles
+#define COUNTER_BR_MSP 4   // mispredicted branches
+#define COUNTER_TOT_INS 5  // instructions
+#define COUNTER_EVENTS 6
+
+#define COUNTER_UNAVAILABLE -1LL // value of an event the backend couldn't count
+
+typedef enum {
+    COUNTERS_NONE,
+    COUNTERS_PERF,
+    COUNTERS_PAPI
+} counterBackend_t;
+
+typedef struct {
+    counterBackend_t backend;
+    int papi_event_set;
+    int papi_slot[COUNTER_EVENTS];  // index into PAPI_stop's values, -1 if not added
+    int perf_fd[COUNTER_EVENTS];    // -1 if the event couldn't be opened
+} counterSet_t;
+
+/*-----------------------------------------------------
+* Function: counters_valid_request
+*
+* Description: Checks a --counters argument
+*
+* param requested: const char*: "auto", "papi", "perf" or "none"
+*
+* return: bool: false if the name isn't recognised
+*--------------------------------------------------------*/
+bool counters_valid_request(const char* requested);
+
+
+/*-----------------------------------------------------
+* Function: counters_init
+*
+* Description: Picks the counter backend for the process. "auto"
+* tries PAPI (if built in), then perf_event_open, then counts nothing;
+* naming a backend that isn't usable also falls back to counting nothing
+* instead of aborting. The name must pass counters_valid_request.
+* Call once from the main thread before any counters_thread_start.
+*
+* param requested: const char*: "auto", "papi", "perf" or "none"
+*
+* return: counterBackend_t: the backend in use
+*--------------------------------------------------------*/
+counterBackend_t counters_init(const char* requested);
+
+
+/*-----------------------------------------------------
+* Function: counters_backend_name
+*
+* Description: Name of a backend for printing
+*
+* param which: counterBackend_t
+*
+* return: const char*
+*--------------------------------------------------------*/
+const char* counters_backend_name(counterBackend_t which);
+
+
+/*-----------------------------------------------------
+* Function: counters_thread_start
+*
+* Description: Starts counting the calling thread's events as one
+* group, so they are scheduled on the PMU together. Events the
+* hardware or kernel doesn't offer are skipped.
+*
+* param set: counterSet_t*: output, the calling thread's counters
+*
+* return: void
+*--------------------------------------------------------*/
+void counters_thread_start(counterSet_t* set);
+
+
+/*-----------------------------------------------------
+* Function: counters_thread_read
+*
+* Description: Reads the running totals without stopping the
+* counters. Must be called from the thread that started them.
+*
+* param set: counterSet_t*: counters from counters_thread_start
+* param values: long long*: output, COUNTER_EVENTS values, COUNTER_UNAVAILABLE
+* for skipped events
+*
+* return: void
+*--------------------------------------------------------*/
+void counters_thread_read(counterSet_t* set, long long* values);
+
+
+/*-----------------------------------------------------
+* Function: counters_thread_stop
+*
+* Description: Stops counting and releases the thread's counters.
+* Must be called from the thread that started them.
+*
+* param set: counterSet_t*: counters from counters_thread_start
+* param values: long long*: output, COUNTER_EVENTS values, COUNTER_UNAVAILABLE
+* for skipped events
+*
+* return: void
+*--------------------------------------------------------*/
+void counters_thread_stop(counterSet_t* set, long long* values);
+
+#endif // _COUNTERS_HPP
@@ -15,36 +15,68 @@
 #include <iostream>
 #include <pthread.h>
 #include <chrono>
+#include <cstring>
 #include "processing.hpp"
+#include "topology.hpp"
+#include "trace.hpp"
+#include "counters.hpp"
+#include "metrics.hpp"
+#include "realtime.hpp"
+#include "autotune.hpp"
+#include "frame_source.hpp"
 
-extern "C" {
-	#include <papi.h>
-}
-
-#define NUM_THREADS 4
-#define TOT_EVENTS 6
+#define NUM_THREADS 4 // workers when neither --threads nor --autotune picks a count
+#define TUNE_BUDGET_MS 300
+#define TRACE_EVENTS_PER_THREAD (1 << 16)
+#define METRICS_WINDOW_FRAMES 30 // frames per worker utilisation / hardware counter update
 
 using namespace cv;
 using namespace std;
 
 // initialize threads for parallelization of image processing
-pthread_t threads[NUM_THREADS];
+int num_threads = NUM_THREADS;
+int strip_rows = 0; // 0: grayscale, barrier, then Sobel; > 0: to442_edge_strips, strips this many rows high
+vector<pthread_t> threads;
 pthread_barrier_t barrier;
-void *thread_statuses[NUM_THREADS];
 bool frames_remaining = true;
+int frame_index = -1; // frame the workers are on, set by main before the load barrier
+bool frame_degraded = false; // real-time mode: process the half resolution copy this frame
+vector<threadArgs_t> half_thread_args; // the workers' bands of the half resolution copy
+
+// live metrics, registered by main before the workers start
+typedef struct {
+    metricCounter_t* busy;          // ns spent in the kernels
+    metricCounter_t* barrier_wait;  // ns spent in pthread_barrier_wait
+    metricGauge_t* utilisation;     // busy share of the last METRICS_WINDOW_FRAMES frames
+    metricCounter_t* hw_events[COUNTER_EVENTS];
+} workerMetrics_t;
+
+vector<workerMetrics_t> worker_metrics;
+metricLatency_t* grayscale_latency;
+metricLatency_t* sobel_latency;
+metricLatency_t* strips_latency;
+bool metrics_on = false; // hardware counters are only read mid-run when someone is scraping
+
+static const char* counter_names[COUNTER_EVENTS] = {
+    "l1_data_cache_misses", "l1_instr_cache_misses", "l2_data_cache_misses",
+    "cycles", "branch_mispredicts", "instructions"
+};
 
 /*-----------------------------------------------------
-* Function: handle_papi_error
+* Function: print_per_frame
 *
-* Description: Handle papi error by printing error and
-* exiting code with error 1
+* Description: Prints a counter averaged over the frames, or n/a
+* if the counter backend couldn't count it
 *
-* param retval: int: return value of papi command
+* param label: const char*: what was counted
+* param value: long long: counter total, or COUNTER_UNAVAILABLE
+* param frames: double: frames processed
 *--------------------------------------------------------*/ 
-void handle_papi_error(int retval) {
-    if (retval != PAPI_OK) {
-        cerr << "PAPI error: " << PAPI_strerror(retval) << endl;
-        exit(1);
+void print_per_frame(const char* label, long long value, double frames) {
+    if (value == COUNTER_UNAVAILABLE) {
+        cout << label << ": n/a" << endl;
+    } else {
+        cout << label << ": " << value / frames << endl;
     }
 }
 
@@ -61,73 +93,216 @@ void handle_papi_error(int retval) {
 void* process_quadrant(void* threadArgs) {
     threadArgs_t* args = static_cast<threadArgs_t*>(threadArgs);
 
-    // Pin thread to core
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(args->thread_id, &cpuset);
-    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+    // Pin thread to the core chosen by pick_worker_cpus
+    int pin_err = pin_thread_to_cpus(pthread_self(), vector<int>{args->cpu});
+    if (pin_err != 0) {
+        fprintf(stderr, "Warning: couldn't pin worker %d to CPU %d: %s\n", args->thread_id, args->cpu, strerror(pin_err));
+    }
+
+    char trace_name[32];
+    snprintf(trace_name, sizeof(trace_name), "worker %d", args->thread_id);
+    trace_thread_name(trace_name);
 
-	int EventSet = PAPI_NULL;
-	long long values[TOT_EVENTS]; // holds event counter results
+    // First-touch this worker's rows so their pages land on the worker's NUMA node. Bands
+    // share a halo row of gray with each neighbour, so only the rows between the halos are
+    // touched here; the Sobel rows of neighbouring bands don't overlap.
+    int gray_first = (args->row_0 == 0) ? 0 : args->row_0 + 1;
+    int gray_end = (args->row_0 + args->h == args->gray->rows) ? args->gray->rows : args->row_0 + args->h - 1;
+    for (int row = gray_first; row < gray_end; row++) {
+        memset(args->gray->ptr<uchar>(row), 0, args->gray->cols);
+    }
+    for (int row = args->row_0; row < args->row_0 + args->h - 2; row++) {
+        memset(args->sobel->ptr<uchar>(row), 0, args->sobel->cols);
+    }
 
-	// Create the Event Set
-	handle_papi_error(PAPI_create_eventset(&EventSet));
+	counterSet_t counters;
+	long long values[COUNTER_EVENTS]; // holds event counter results
 
-	// Add all events of interest to the Event Set
-    handle_papi_error(PAPI_add_event(EventSet, PAPI_L1_DCM));
-    handle_papi_error(PAPI_add_event(EventSet, PAPI_L1_ICM));
-    handle_papi_error(PAPI_add_event(EventSet, PAPI_L2_DCM));
-    handle_papi_error(PAPI_add_event(EventSet, PAPI_TOT_CYC));
-    handle_papi_error(PAPI_add_event(EventSet, PAPI_BR_MSP));
-    handle_papi_error(PAPI_add_event(EventSet, PAPI_TOT_INS));
+	// Start counting this thread's events with the backend main picked
+    counters_thread_start(&counters);
 
-	// Start counting events in the Event Set
-    handle_papi_error(PAPI_start(EventSet));
+    Mat strip_gray; // strip mode: gray rows of the current strip, private to this worker
+    workerMetrics_t* metrics = &worker_metrics[args->thread_id];
+    long long published[COUNTER_EVENTS] = {0}; // hardware counts already added to the metrics
+    uint64_t window_busy = 0;
+    uint64_t window_total = 0;
+    int window_frames = 0;
 
+    // each span starts where the last one ended, so one clock read per step
+    uint64_t t = trace_now_ns();
     while (frames_remaining) {
         pthread_barrier_wait(&barrier); // wait for main thread to load the current frame
-        to442_grayscale(args->src, args->gray, args->row_0, args->col_0, args->h, args->w);
+        uint64_t t_loaded = trace_span("wait load", t, frame_index);
+
+        threadArgs_t* band = frame_degraded ? &half_thread_args[args->thread_id] : args;
+        if (strip_rows > 0) {
+            // the whole band in strips, through this worker's own gray scratch
+            to442_edge_strips(band->src, &strip_gray, band->sobel, band->row_0, band->col_0, band->h, band->w, strip_rows);
+        } else {
+            to442_grayscale(band->src, band->gray, band->row_0, band->col_0, band->h, band->w);
+        }
+        uint64_t t_gray = trace_span(strip_rows > 0 ? "grayscale + sobel" : "grayscale", t_loaded, frame_index);
+
         pthread_barrier_wait(&barrier); // wait for all other worker threads to be done grayscaling
-        to442_sobel(args->gray, args->sobel, args->row_0, args->col_0, args->h, args->w);
+        uint64_t t_gray_synced = trace_span("wait grayscale", t_gray, frame_index);
+
+        uint64_t t_sobel = t_gray_synced;
+        if (strip_rows == 0) {
+            to442_sobel(band->gray, band->sobel, band->row_0, band->col_0, band->h, band->w);
+            t_sobel = trace_span("sobel", t_gray_synced, frame_index);
+        }
+
         pthread_barrier_wait(&barrier); // wait for all other work threads to be done applying sobel
+        uint64_t t_done = trace_span("wait sobel", t_sobel, frame_index);
+
+        uint64_t busy = (t_gray - t_loaded) + (t_sobel - t_gray_synced);
+        if (strip_rows > 0) {
+            metrics_observe_ns(strips_latency, t_gray - t_loaded);
+        } else {
+            metrics_observe_ns(grayscale_latency, t_gray - t_loaded);
+            metrics_observe_ns(sobel_latency, t_sobel - t_gray_synced);
+        }
+        metrics_add(metrics->busy, busy);
+        metrics_add(metrics->barrier_wait, (t_done - t) - busy);
+
+        window_busy += busy;
+        window_total += t_done - t;
+        if (++window_frames == METRICS_WINDOW_FRAMES) {
+            metrics_set(metrics->utilisation, (double)window_busy / window_total);
+            if (metrics_on) {
+                long long now[COUNTER_EVENTS];
+                counters_thread_read(&counters, now);
+                for (int e = 0; e < COUNTER_EVENTS; e++) {
+                    if (now[e] != COUNTER_UNAVAILABLE && now[e] > published[e]) {
+                        metrics_add(metrics->hw_events[e], now[e] - published[e]);
+                        published[e] = now[e];
+                    }
+                }
+            }
+            window_busy = 0;
+            window_total = 0;
+            window_frames = 0;
+        }
+        t = t_done;
     }
 
-    // Stop the counting of events in the Event Set
-    handle_papi_error(PAPI_stop(EventSet, values));
+    // Stop counting and release the counters
+    counters_thread_stop(&counters, values);
 
     // store counter values into threadargs to read back in main
-    args->l1_data_cache_misses = values[0];
-    args->l1_instr_cache_misses = values[1];
-    args->l2_data_cache_misses = values[2];
-    args->tot_cycles = values[3];
-    args->branch_mispredicts = values[4];
-    args->tot_intructions = values[5];
-
-    PAPI_cleanup_eventset(EventSet);
-    PAPI_destroy_eventset(&EventSet);
+    args->l1_data_cache_misses = values[COUNTER_L1_DCM];
+    args->l1_instr_cache_misses = values[COUNTER_L1_ICM];
+    args->l2_data_cache_misses = values[COUNTER_L2_DCM];
+    args->tot_cycles = values[COUNTER_TOT_CYC];
+    args->branch_mispredicts = values[COUNTER_BR_MSP];
+    args->tot_intructions = values[COUNTER_TOT_INS];
     return NULL;
 }
 
 int main(int argc, char** argv) {
     auto start = chrono::high_resolution_clock::now(); // start timer for runtime
-    if (argc != 2) {
-        cerr << "Incorrect usage - use via: 'edge_detector [video_path]'" << endl;
+
+    // optional trailing options, in any order:
+    //   "--trace out.json": record per-thread spans and dump them for Perfetto
+    //   "--counters auto|papi|perf|none": hardware counter backend
+    //   "--metrics [host:]port|unix:path": serve live Prometheus metrics there
+    //   "--realtime off|drop|degrade": play at the source FPS, dropping (and degrading) late frames
+    //   "--autotune on|refresh|off": use the fastest worker count and kernel variant for this host
+    //       and resolution, benchmarked on the first run and cached ("refresh" benchmarks again)
+    //   "--threads N", "--strip-rows S": set them by hand, overriding the autotuned values
+    const char* trace_path = NULL;
+    const char* counters_requested = "auto";
+    const char* metrics_address = NULL;
+    rtPolicy_t rt_policy = RT_OFF;
+    bool autotune = false;
+    bool autotune_refresh = false;
+    int threads_requested = 0;
+    int strip_rows_requested = -1;
+    while (argc >= 3 && strncmp(argv[argc-2], "--", 2) == 0) {
+        if (strcmp(argv[argc-2], "--trace") == 0) {
+            trace_path = argv[argc-1];
+        } else if (strcmp(argv[argc-2], "--counters") == 0) {
+            counters_requested = argv[argc-1];
+            if (!counters_valid_request(counters_requested)) {
+                cerr << "Error: --counters takes auto, papi, perf or none" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[argc-2], "--metrics") == 0) {
+            metrics_address = argv[argc-1];
+        } else if (strcmp(argv[argc-2], "--realtime") == 0) {
+            if (!rt_parse_policy(argv[argc-1], &rt_policy)) {
+                cerr << "Error: --realtime takes off, drop or degrade" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[argc-2], "--autotune") == 0) {
+            autotune = strcmp(argv[argc-1], "off") != 0;
+            autotune_refresh = strcmp(argv[argc-1], "refresh") == 0;
+            if (autotune && !autotune_refresh && strcmp(argv[argc-1], "on") != 0) {
+                cerr << "Error: --autotune takes on, refresh or off" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[argc-2], "--threads") == 0) {
+            threads_requested = atoi(argv[argc-1]);
+            if (threads_requested < 1) {
+                cerr << "Error: --threads takes a positive count" << endl;
+                return -1;
+            }
+        } else if (strcmp(argv[argc-2], "--strip-rows") == 0) {
+            strip_rows_requested = atoi(argv[argc-1]);
+            if (strip_rows_requested < 0) {
+                cerr << "Error: --strip-rows takes 0 (separate passes) or a row count" << endl;
+                return -1;
+            }
+        } else {
+            break;
+        }
+        argc -= 2;
+    }
+    if (argc < 2 || argc > 4) {
+        cerr << "Incorrect usage - use via: 'edge_detector [video_path|synth:WxH[@fps][:gradient|noise|edges|mix[:frames]]] [prefetch_rows = 0] [stream_stores = {0/1}] [--trace out.json] [--counters auto|papi|perf|none] [--metrics [host:]port|unix:path] [--realtime off|drop|degrade] [--autotune on|refresh|off] [--threads N] [--strip-rows S]'" << endl;
         return -1;
     }
+    if (trace_path != NULL) {
+        // before the workers start, so they all see it enabled
+        trace_enable(TRACE_EVENTS_PER_THREAD);
+        trace_thread_name("main");
+    }
+
+    // memory hints for the kernels; compare the cache miss counts with them on and off
+    int prefetch_rows = (argc > 2) ? atoi(argv[2]) : 0;
+    bool stream_stores = (argc > 3) && atoi(argv[3]) != 0;
+    to442_set_mem_hints(prefetch_rows, stream_stores);
+    cout << "Prefetch distance: " << prefetch_rows << " rows, streaming stores: " << (stream_stores ? "on" : "off") << endl;
     
-	// Initialize the PAPI library
-	int retval = PAPI_library_init(PAPI_VER_CURRENT);
-	if (retval != PAPI_VER_CURRENT) {
-        handle_papi_error(retval);
-	}
+    // Pick the hardware counter backend; without one the run continues uncounted
+    counterBackend_t counter_backend = counters_init(counters_requested);
+    cout << "Hardware counters: " << counters_backend_name(counter_backend) << endl;
 
-    // Initialize thread support
-    handle_papi_error(PAPI_thread_init(pthread_self));
+    // Register the live metrics before the workers start; updates from then on are lock-free
+    metricCounter_t* frames_total = metrics_counter("edge_frames_total", "", "Frames processed");
+    metricGauge_t* fps_gauge = metrics_gauge("edge_fps", "", "Frames per second over the last second");
+    metricLatency_t* decode_latency = metrics_latency("edge_stage_seconds", "stage=\"decode\"", "Time per frame in each pipeline stage");
+    grayscale_latency = metrics_latency("edge_stage_seconds", "stage=\"grayscale\"", "");
+    sobel_latency = metrics_latency("edge_stage_seconds", "stage=\"sobel\"", "");
+    strips_latency = metrics_latency("edge_stage_seconds", "stage=\"grayscale_sobel_strips\"", "");
+    metricLatency_t* display_latency = metrics_latency("edge_stage_seconds", "stage=\"display\"", "");
+    metricLatency_t* frame_latency = metrics_latency("edge_frame_seconds", "", "Decode to displayed, per frame");
+    metricCounter_t* dropped_stale = metrics_counter("edge_frames_dropped_total", "reason=\"stale\"", "Real-time mode: frames skipped, by reason");
+    metricCounter_t* degraded_overrun = metrics_counter("edge_frames_degraded_total", "reason=\"predicted_overrun\"", "Real-time mode: frames processed at half resolution, by reason");
+    metricCounter_t* late_frames = metrics_counter("edge_frames_late_total", "", "Real-time mode: frames shown after their deadline");
+    metricCounter_t* main_wait = metrics_counter("edge_barrier_wait_seconds_total", "thread=\"main\"", "Time spent waiting at the frame barriers", 1e-9);
+    if (metrics_address != NULL) {
+        if (metrics_serve(metrics_address) != 0) {
+            return -1;
+        }
+        metrics_on = true;
+        cout << "Serving metrics on " << metrics_address << endl;
+    }
 
-	// Initialize video reader
+	// Initialize video reader, or the synthetic source for a synth: spec
     string cap_path = argv[1];
-    VideoCapture cap(cap_path);
-    if (!cap.isOpened()) {
+    frameSource_t cap;
+    if (!source_open(&cap, cap_path)) {
         cerr << "Error: Could not open video file: " << cap_path << endl;
         return -1;
     } else {
@@ -135,12 +310,89 @@ int main(int argc, char** argv) {
     }
 
     // get and print video attributes
-    int frame_count = static_cast<int>(cap.get(CAP_PROP_FRAME_COUNT));
-    double fps = cap.get(CAP_PROP_FPS);
-    int height = static_cast<int>(cap.get(CAP_PROP_FRAME_HEIGHT));    
-    int width = static_cast<int>(cap.get(CAP_PROP_FRAME_WIDTH));
+    int frame_count = static_cast<int>(source_get(&cap, CAP_PROP_FRAME_COUNT));
+    double fps = source_get(&cap, CAP_PROP_FPS);
+    int height = static_cast<int>(source_get(&cap, CAP_PROP_FRAME_HEIGHT));    
+    int width = static_cast<int>(source_get(&cap, CAP_PROP_FRAME_WIDTH));
     cout << "Total frames: " << frame_count << ", FPS: " << fps << endl;
     cout << "Width: " << width << ", Height: " << height << endl;
+    // the half resolution copy used by --realtime degrade still needs 3x3 for Sobel
+    if (width < 6 || height < 6) {
+        cerr << "Error: frames must be at least 6x6, got " << width << "x" << height << endl;
+        return -1;
+    }
+
+    // Worker count and kernel variant: the autotuned result for this host and resolution,
+    // benchmarked once and then read from the cache, unless set by hand
+    vector<cpuInfo_t> topology = read_cpu_topology();
+    if (autotune) {
+        string tune_key = tune_cache_key(topology, width, height);
+        string tune_path = tune_default_cache_path();
+        tuneConfig_t tuned;
+        if (!autotune_refresh && tune_cache_load(tune_path, tune_key, &tuned)) {
+            cout << "Autotune: cached result for " << tune_key << " from " << tune_path << endl;
+        } else {
+            cout << "Autotune: benchmarking " << tune_key << endl;
+            tuned = tune_benchmark(topology, width, height, TUNE_BUDGET_MS);
+            if (!tune_cache_save(tune_path, tune_key, tuned)) {
+                cerr << "Warning: Could not write autotune cache: " << tune_path << endl;
+            }
+        }
+        num_threads = tuned.threads;
+        strip_rows = tuned.strip_rows;
+    }
+    if (threads_requested > 0) {
+        num_threads = threads_requested;
+    }
+    if (strip_rows_requested >= 0) {
+        strip_rows = strip_rows_requested;
+    }
+    // every band needs a row of its own, in the half resolution copy too
+    int max_workers = max(height / 2, 1);
+    if (num_threads > max_workers) {
+        cout << "Using " << max_workers << " workers rather than " << num_threads << " for " << height << " rows" << endl;
+        num_threads = max_workers;
+    }
+    if (strip_rows > 0) {
+        cout << "Kernel: grayscale and Sobel in strips of " << strip_rows << " rows" << endl;
+    } else {
+        cout << "Kernel: separate grayscale and Sobel passes" << endl;
+    }
+
+    // Keep the main thread (and so the decoded frames it first-touches)
+    // on the same NUMA node as the workers
+    int worker_node = 0;
+    vector<cpuInfo_t> worker_cpus = pick_worker_cpus(topology, num_threads, &worker_node);
+    int pin_err = pin_thread_to_cpus(pthread_self(), node_cpus(topology, worker_node));
+    if (pin_err != 0) {
+        fprintf(stderr, "Warning: couldn't pin the main thread to NUMA node %d: %s\n", worker_node, strerror(pin_err));
+    }
+    cout << "Placing " << num_threads << " workers on NUMA node " << worker_node << endl;
+
+    // per-worker metrics, now that the worker count is known
+    worker_metrics.resize(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+        char labels[64];
+        snprintf(labels, sizeof(labels), "thread=\"worker %d\"", i);
+        worker_metrics[i].barrier_wait = metrics_counter("edge_barrier_wait_seconds_total", labels, "", 1e-9);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        char labels[64];
+        snprintf(labels, sizeof(labels), "worker=\"%d\"", i);
+        worker_metrics[i].busy = metrics_counter("edge_worker_busy_seconds_total", labels, "Time spent in the grayscale and Sobel kernels", 1e-9);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        char labels[64];
+        snprintf(labels, sizeof(labels), "worker=\"%d\"", i);
+        worker_metrics[i].utilisation = metrics_gauge("edge_worker_utilisation", labels, "Share of recent frame time spent in the kernels rather than at barriers");
+    }
+    for (int i = 0; i < num_threads; i++) {
+        for (int e = 0; e < COUNTER_EVENTS; e++) {
+            char labels[96];
+            snprintf(labels, sizeof(labels), "worker=\"%d\",event=\"%s\"", i, counter_names[e]);
+            worker_metrics[i].hw_events[e] = metrics_counter("edge_hw_events_total", labels, "Hardware counter totals, updated every few frames");
+        }
+    }
 
     // define Mats for each processing stage to be accessed by threads
     Mat frame;
@@ -151,22 +403,34 @@ int main(int argc, char** argv) {
     pthread_attr_t attr;
     pthread_attr_init(&attr);
     pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-    pthread_barrier_init(&barrier, NULL, NUM_THREADS+1);
+    pthread_barrier_init(&barrier, NULL, num_threads+1);
 
-    // calc quadrant dims, assuming even dims
-    int sub_h = height / 4;
-    
-    // set threadArgs for each quadrant
-    threadArgs_t row_0_args = {&frame, &frame_gray, &frame_sobel, 0,         0, sub_h+2, width, 0, 0, 0, 0, 0, 0, 0};
-    threadArgs_t row_1_args = {&frame, &frame_gray, &frame_sobel, sub_h-1,   0, sub_h+2, width, 1, 0, 0, 0, 0, 0, 0};
-    threadArgs_t row_2_args = {&frame, &frame_gray, &frame_sobel, 2*sub_h-1, 0, sub_h+2, width, 2, 0, 0, 0, 0, 0, 0};
-    threadArgs_t row_3_args = {&frame, &frame_gray, &frame_sobel, 3*sub_h-1, 0, sub_h+1, width, 3, 0, 0, 0, 0, 0, 0};
+    // set threadArgs for each band of rows
+    vector<threadArgs_t> thread_args(num_threads);
+    half_thread_args.resize(num_threads);
+    to442_split_rows(thread_args.data(), num_threads, &frame, &frame_gray, &frame_sobel);
 
-    threadArgs_t thread_args[] = {row_0_args, row_1_args, row_2_args, row_3_args};
-    int pthread_create_ret_vals[NUM_THREADS];
+    // real-time mode: a half resolution copy for frames that wouldn't make their deadline
+    rtScheduler_t rt;
+    rt_init(&rt, rt_policy, fps);
+    Mat frame_half(height/2, width/2, CV_8UC3);
+    Mat frame_gray_half(height/2, width/2, CV_8UC1);
+    Mat frame_sobel_half(height/2-2, width/2-2, CV_8UC1);
+    to442_split_rows(half_thread_args.data(), num_threads, &frame_half, &frame_gray_half, &frame_sobel_half);
+    for (int i = 0; i < num_threads; i++) {
+        thread_args[i].cpu = worker_cpus[i].cpu;
+        half_thread_args[i].cpu = worker_cpus[i].cpu;
+    }
+    if (rt_policy != RT_OFF) {
+        cout << "Real-time mode: " << (rt_policy == RT_DEGRADE ? "drop and degrade" : "drop")
+             << ", " << rt.period_ns / 1e6 << " ms per frame" << endl;
+    }
+    vector<int> pthread_create_ret_vals(num_threads);
 
     // start each child thread and check creation return values
-    for (int i = 0; i < NUM_THREADS; i++) {
+    threads.resize(num_threads);
+    for (int i = 0; i < num_threads; i++) {
+        cout << "Worker " << i << " -> " << describe_cpu(worker_cpus[i]) << endl;
         pthread_create_ret_vals[i] = pthread_create(&threads[i], NULL, process_quadrant, (void*)&thread_args[i]);
         if (pthread_create_ret_vals[i] != 0) {
             fprintf(stderr, "pthread_create #%d failed: %d\n", i, pthread_create_ret_vals[i]);
@@ -175,26 +439,75 @@ int main(int argc, char** argv) {
     }
 
     // Read and display each frame of the video
+    uint64_t t = trace_now_ns();
+    uint64_t fps_window_start = t;
+    int fps_window_frames = 0;
     for (int i = 0; i < frame_count; i++) {
-        bool ret = cap.read(frame);
+        t = rt_wait_release(&rt, i, t);
+        rtDecision_t decision = rt_decide(&rt, i, t);
+        if (decision == RT_SKIP) {
+            // a newer frame is already due; grab() skips the conversion to BGR
+            bool ret = source_grab(&cap);
+            if (!ret) {
+                cout << "Error occurred in reading a frame." << endl;
+                return 1;
+            }
+            t = trace_span("drop", t, i);
+            metrics_add(dropped_stale, 1);
+            continue;
+        }
+
+        bool ret = source_read(&cap, frame);
         if (!ret) {
             cout << "Error occurred in reading a frame." << endl;
             return 1;
         }
+        frame_degraded = decision == RT_HALF;
+        if (frame_degraded) {
+            resize(frame, frame_half, frame_half.size(), 0, 0, INTER_NEAREST);
+            metrics_add(degraded_overrun, 1);
+        }
+        uint64_t t_decoded = trace_span(frame_degraded ? "decode + downscale" : "decode", t, i);
+        frame_index = i;
+
         // barrier to prevent worker threads from processing until the new frame is loaded
         pthread_barrier_wait(&barrier);
+        uint64_t t_loaded = trace_span("wait load", t_decoded, i);
 
         // wait for worker threads to grayscale current frame
         pthread_barrier_wait(&barrier);
+        uint64_t t_gray = trace_span("wait grayscale", t_loaded, i);
 
         // wait for worker threads to sobel filter current frame
         pthread_barrier_wait(&barrier);
+        uint64_t t_sobel = trace_span("wait sobel", t_gray, i);
         
-        // Display the frame
+        // Display the frame, scaled back up if it was processed at half resolution
+        if (frame_degraded) {
+            resize(frame_sobel_half, frame_sobel, frame_sobel.size(), 0, 0, INTER_NEAREST);
+        }
         imshow("Display Window", frame_sobel);
 
         // Wait for appropriate time between frames and check if 'q' is pressed to exit
         char key = waitKey(1);
+        uint64_t t_shown = trace_span("display", t_sobel, i);
+
+        int late_before = rt.late;
+        rt_finished(&rt, i, decision, t, t_shown);
+        metrics_add(late_frames, rt.late - late_before);
+        metrics_observe_ns(decode_latency, t_decoded - t);
+        metrics_observe_ns(display_latency, t_shown - t_sobel);
+        metrics_observe_ns(frame_latency, t_shown - t);
+        metrics_add(main_wait, t_sobel - t_decoded);
+        metrics_add(frames_total, 1);
+        fps_window_frames++;
+        if (t_shown - fps_window_start >= 1000000000ULL) {
+            metrics_set(fps_gauge, fps_window_frames * 1e9 / (t_shown - fps_window_start));
+            fps_window_start = t_shown;
+            fps_window_frames = 0;
+        }
+        t = t_shown;
+
         if (key == 'q' || getWindowProperty("Display Window", WND_PROP_VISIBLE) < 1) {
             break;
         }
@@ -203,18 +516,19 @@ int main(int argc, char** argv) {
     // Stop all worker threads once all frames have been processed
     // Need three pthread_barrier_waits due to the same number in process_quadrant
     frames_remaining = false;
+    frame_index = -1;
     pthread_barrier_wait(&barrier);
     pthread_barrier_wait(&barrier);
     pthread_barrier_wait(&barrier);
 
     // Join threads (cleanup)
-    for (int i = 0; i < NUM_THREADS; i++) {
+    for (int i = 0; i < num_threads; i++) {
         pthread_join(threads[i], NULL);
     }
     pthread_barrier_destroy(&barrier);
 
     // Release the video capture object and close any OpenCV windows
-    cap.release();
+    source_release(&cap);
     destroyAllWindows();
     waitKey(1);
 
@@ -223,25 +537,55 @@ int main(int argc, char** argv) {
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(stop - start);
     float duration_secs = (float)duration.count()/1000;
     
+    // per frame figures only count the frames that were processed; dropped frames did no work
+    double frames_processed = max(rt.processed, 1);
     long long all_cores_caches_misses_total = 0;
     long long all_cores_cycles_total = 0;
     // Calculate and print the average events counted for each core
-    for (int i = 0; i < NUM_THREADS; i++) {
-        all_cores_caches_misses_total = all_cores_caches_misses_total + thread_args[i].l1_data_cache_misses + thread_args[i].l1_instr_cache_misses + thread_args[i].l2_data_cache_misses;
-        all_cores_cycles_total += thread_args[i].tot_cycles;
-        cout << "Core " << i << " Avg L1 Data Cache Misses Per Frame: " << thread_args[i].l1_data_cache_misses / (double)frame_count << endl;
-        cout << "Core " << i << " Avg L1 Instruction Cache Misses Per Frame: " << thread_args[i].l1_instr_cache_misses / (double)frame_count << endl;
-        cout << "Core " << i << " Avg L2 Data Cache Misses Per Frame: " << thread_args[i].l2_data_cache_misses / (double)frame_count << endl;
-        cout << "Core " << i << " Avg Cycles Per Frame: " << thread_args[i].tot_cycles / (double)frame_count << endl;
-        cout << "Core " << i << " Avg Branch Mispredictions Per Frame: " << thread_args[i].branch_mispredicts / (double)frame_count << endl;
-        cout << "Core " << i << " Avg Instructions Per Frame: " << thread_args[i].tot_intructions / (double)frame_count << endl;
+    for (int i = 0; i < num_threads; i++) {
+        // totals only sum events every core counted
+        long long misses[] = {thread_args[i].l1_data_cache_misses, thread_args[i].l1_instr_cache_misses, thread_args[i].l2_data_cache_misses};
+        for (long long m : misses) {
+            if (m == COUNTER_UNAVAILABLE || all_cores_caches_misses_total == COUNTER_UNAVAILABLE) {
+                all_cores_caches_misses_total = COUNTER_UNAVAILABLE;
+            } else {
+                all_cores_caches_misses_total += m;
+            }
+        }
+        if (thread_args[i].tot_cycles == COUNTER_UNAVAILABLE || all_cores_cycles_total == COUNTER_UNAVAILABLE) {
+            all_cores_cycles_total = COUNTER_UNAVAILABLE;
+        } else {
+            all_cores_cycles_total += thread_args[i].tot_cycles;
+        }
+        string core = "Core " + to_string(i);
+        print_per_frame((core + " Avg L1 Data Cache Misses Per Frame").c_str(), thread_args[i].l1_data_cache_misses, frames_processed);
+        print_per_frame((core + " Avg L1 Instruction Cache Misses Per Frame").c_str(), thread_args[i].l1_instr_cache_misses, frames_processed);
+        print_per_frame((core + " Avg L2 Data Cache Misses Per Frame").c_str(), thread_args[i].l2_data_cache_misses, frames_processed);
+        print_per_frame((core + " Avg Cycles Per Frame").c_str(), thread_args[i].tot_cycles, frames_processed);
+        print_per_frame((core + " Avg Branch Mispredictions Per Frame").c_str(), thread_args[i].branch_mispredicts, frames_processed);
+        print_per_frame((core + " Avg Instructions Per Frame").c_str(), thread_args[i].tot_intructions, frames_processed);
         cout << endl;
     }
     
-    cout << "Avg Total Cache Misses Per Core Per Frame: " << (double)all_cores_caches_misses_total / (NUM_THREADS*frame_count) << endl;
-    cout << "Avg Cycles Per Core Per Frame: " << (double)all_cores_cycles_total / (NUM_THREADS*frame_count) << endl;
+    print_per_frame("Avg Total Cache Misses Per Core Per Frame", all_cores_caches_misses_total, num_threads*frames_processed);
+    print_per_frame("Avg Cycles Per Core Per Frame", all_cores_cycles_total, num_threads*frames_processed);
     cout << "Program Runtime: " << duration_secs << " seconds\n";  // e.g., 150000 us [web:2]
-    cout << "Average FPS: " << frame_count / duration_secs << endl;
+    cout << "Frames processed: " << rt.processed << ", dropped: " << rt.dropped_stale << endl;
+    cout << "Average FPS (processed frames): " << rt.processed / duration_secs << endl;
+    if (rt_policy != RT_OFF) {
+        cout << "Real-time: " << rt.late << " of the processed frames shown late" << endl;
+        cout << "  Dropped: " << rt.dropped_stale << " (stale: the next frame was already due)" << endl;
+        cout << "  Degraded to half resolution: " << rt.degraded_overrun << " (full resolution predicted to miss the deadline)" << endl;
+    }
+
+    if (trace_path != NULL) {
+        int events = trace_write_json(trace_path);
+        if (events < 0) {
+            cerr << "Error: Could not write trace file: " << trace_path << endl;
+            return 1;
+        }
+        cout << "Wrote " << events << " trace events to " << trace_path << endl;
+    }
     
     return 0;
 }
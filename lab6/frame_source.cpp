@@ -0,0 +1,220 @@
+/*******************************************************
+* File: frame_source.cpp
+*
+* Description: Video file, camera or synthetic frame source
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#include "frame_source.hpp"
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+using namespace cv;
+using namespace std;
+
+#define SYNTH_PREFIX "synth:"
+#define SYNTH_DEFAULT_FPS 30.0
+#define SYNTH_DEFAULT_SECONDS 10
+#define SYNTH_NOISE_ROWS 257  // prime, so the per-frame offset visits every row
+#define SYNTH_NOISE_SLACK 64  // extra columns for the per-frame horizontal offset
+#define SYNTH_SQUARE 32       // checkerboard square size in pixels
+#define SYNTH_SPEED_X 4       // checkerboard movement in pixels per frame
+#define SYNTH_SPEED_Y 2
+#define SYNTH_MIN_SIZE 6      // halved for real-time degrade, that is still 3x3 for Sobel
+
+/*-----------------------------------------------------
+* Function: parse_synth
+*
+* Description: Parses the part of a synth: spec after the prefix
+*
+* param spec: const string&: "WxH[@fps][:pattern[:frames]]"
+* param source: frameSource_t*: output size, rate, pattern and length
+*
+* return: bool: false if the spec is malformed
+*--------------------------------------------------------*/
+static bool parse_synth(const string& spec, frameSource_t* source) {
+    vector<string> parts;
+    stringstream fields(spec);
+    string field;
+    while (getline(fields, field, ':')) {
+        parts.push_back(field);
+    }
+    if (parts.empty() || parts.size() > 3) {
+        return false;
+    }
+
+    char extra;
+    size_t at = parts[0].find('@');
+    source->fps = SYNTH_DEFAULT_FPS;
+    if (sscanf(parts[0].substr(0, at).c_str(), "%dx%d%c", &source->width, &source->height, &extra) != 2) {
+        return false;
+    }
+    if (at != string::npos && sscanf(parts[0].substr(at + 1).c_str(), "%lf%c", &source->fps, &extra) != 1) {
+        return false;
+    }
+
+    source->pattern = SYNTH_MIX;
+    if (parts.size() > 1) {
+        const char* names[] = {"gradient", "noise", "edges", "mix"};
+        int i = 0;
+        while (i < 4 && parts[1] != names[i]) {
+            i++;
+        }
+        if (i == 4) {
+            return false;
+        }
+        source->pattern = (synthPattern_t)i;
+    }
+
+    source->frames = (int)(SYNTH_DEFAULT_SECONDS * source->fps + 0.5);
+    if (parts.size() > 2 && sscanf(parts[2].c_str(), "%d%c", &source->frames, &extra) != 1) {
+        return false;
+    }
+    return source->width >= SYNTH_MIN_SIZE && source->height >= SYNTH_MIN_SIZE &&
+           source->fps > 0 && source->frames > 0;
+}
+
+/*-----------------------------------------------------
+* Function: synth_render
+*
+* Description: Generates synthetic frame index. Everything
+* that doesn't change between frames is precomputed in
+* source_open, so this is a few integer ops per pixel.
+*
+* param source: const frameSource_t*
+* param index: int: frame number
+* param frame: Mat&: output, reused if already the right size
+*
+* return: void
+*--------------------------------------------------------*/
+static void synth_render(const frameSource_t* source, int index, Mat& frame) {
+    frame.create(source->height, source->width, CV_8UC3);
+    int width = source->width;
+    int scroll = index & 255;
+    int offset_x = SYNTH_SPEED_X * index;
+    const int* col_ramp = source->col_ramp.data();
+    for (int y = 0; y < source->height; y++) {
+        uchar* out = frame.ptr<uchar>(y);
+        int row_ramp = source->row_ramp[y];
+        int square_y = ((y + SYNTH_SPEED_Y * index) / SYNTH_SQUARE) & 1;
+        const uchar* noise = NULL;
+        if (!source->noise.empty()) {
+            noise = source->noise.ptr<uchar>((y + 61 * index) % SYNTH_NOISE_ROWS) + 3 * ((37 * index) % SYNTH_NOISE_SLACK);
+        }
+
+        switch (source->pattern) {
+        case SYNTH_GRADIENT:
+            for (int x = 0; x < width; x++) {
+                out[3*x]     = (uchar)((col_ramp[x] + scroll) & 255);
+                out[3*x + 1] = (uchar)((row_ramp + scroll) & 255);
+                out[3*x + 2] = (uchar)((col_ramp[x] + row_ramp) >> 1);
+            }
+            break;
+        case SYNTH_NOISE:
+            memcpy(out, noise, 3 * width);
+            break;
+        case SYNTH_EDGES:
+            for (int x = 0; x < width; x++) {
+                uchar value = ((((x + offset_x) / SYNTH_SQUARE) & 1) ^ square_y) ? 220 : 30;
+                out[3*x] = out[3*x + 1] = out[3*x + 2] = value;
+            }
+            break;
+        case SYNTH_MIX:
+            for (int x = 0; x < width; x++) {
+                int base = ((((x + offset_x) / SYNTH_SQUARE) & 1) ^ square_y) ? 128 : 0;
+                out[3*x]     = (uchar)(base + (col_ramp[x] >> 2) + (noise[3*x] >> 3));
+                out[3*x + 1] = (uchar)(base + (row_ramp >> 2) + (noise[3*x + 1] >> 3));
+                out[3*x + 2] = (uchar)(base + ((col_ramp[x] + row_ramp) >> 3) + (noise[3*x + 2] >> 3));
+            }
+            break;
+        }
+    }
+}
+
+bool source_open(frameSource_t* source, const string& path) {
+    source->synthetic = path.compare(0, strlen(SYNTH_PREFIX), SYNTH_PREFIX) == 0;
+    if (!source->synthetic) {
+        return source->cap.open(path);
+    }
+    if (!parse_synth(path.substr(strlen(SYNTH_PREFIX)), source)) {
+        cerr << "Error: Synthetic sources take synth:WxH[@fps][:gradient|noise|edges|mix[:frames]]"
+             << " with W and H at least " << SYNTH_MIN_SIZE << endl;
+        return false;
+    }
+    source->next = 0;
+
+    source->col_ramp.resize(source->width);
+    for (int x = 0; x < source->width; x++) {
+        source->col_ramp[x] = x * 256 / source->width;
+    }
+    source->row_ramp.resize(source->height);
+    for (int y = 0; y < source->height; y++) {
+        source->row_ramp[y] = y * 256 / source->height;
+    }
+
+    // fixed seed, so every run sees the same frames
+    source->noise.release();
+    if (source->pattern == SYNTH_NOISE || source->pattern == SYNTH_MIX) {
+        source->noise.create(SYNTH_NOISE_ROWS, 3 * (source->width + SYNTH_NOISE_SLACK), CV_8UC1);
+        uint32_t seed = 12345;
+        for (int row = 0; row < source->noise.rows; row++) {
+            uchar* pixel = source->noise.ptr<uchar>(row);
+            for (int i = 0; i < source->noise.cols; i++) {
+                seed = seed * 1664525u + 1013904223u;
+                pixel[i] = (uchar)(seed >> 24);
+            }
+        }
+    }
+    return true;
+}
+
+bool source_read(frameSource_t* source, Mat& frame) {
+    if (!source->synthetic) {
+        return source->cap.read(frame);
+    }
+    if (source->next >= source->frames) {
+        return false;
+    }
+    synth_render(source, source->next++, frame);
+    return true;
+}
+
+bool source_grab(frameSource_t* source) {
+    if (!source->synthetic) {
+        return source->cap.grab();
+    }
+    if (source->next >= source->frames) {
+        return false;
+    }
+    source->next++;
+    return true;
+}
+
+double source_get(const frameSource_t* source, int prop) {
+    if (!source->synthetic) {
+        return source->cap.get(prop);
+    }
+    switch (prop) {
+    case CAP_PROP_FRAME_COUNT:
+        return source->frames;
+    case CAP_PROP_FPS:
+        return source->fps;
+    case CAP_PROP_FRAME_WIDTH:
+        return source->width;
+    case CAP_PROP_FRAME_HEIGHT:
+        return source->height;
+    default:
+        return 0;
+    }
+}
+
+void source_release(frameSource_t* source) {
+    source->cap.release();
+    source->noise.release();
+    source->next = source->frames;
+}
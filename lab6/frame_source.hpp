@@ -0,0 +1,116 @@
+/*******************************************************
+* File: frame_source.hpp
+*
+* Description: Frame source for the drivers, either a video
+* file or camera through VideoCapture, or a synthetic source
+* that generates deterministic frames at any resolution:
+*
+*   synth:WxH[@fps][:pattern[:frames]]
+*
+* where pattern is "gradient", "noise", "edges" (a moving
+* checkerboard) or "mix" (all three, the default). W and H
+* must be at least 6, fps defaults to 30 and frames to ten
+* seconds' worth. Frame i is the same on every run, and
+* generating it costs about as much as a copy, so scaling
+* runs aren't skewed by decode.
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#ifndef _FRAME_SOURCE_HPP
+#define _FRAME_SOURCE_HPP
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+
+typedef enum {
+    SYNTH_GRADIENT, // color ramps, scrolling one step per frame
+    SYNTH_NOISE,    // pseudo-random pixels, different every frame
+    SYNTH_EDGES,    // a checkerboard moving right and down
+    SYNTH_MIX       // checkerboard over ramps with some noise
+} synthPattern_t;
+
+typedef struct {
+    cv::VideoCapture cap;     // used when synthetic is false
+    bool synthetic;
+    int width;
+    int height;
+    double fps;
+    int frames;               // frames in the synthetic stream
+    synthPattern_t pattern;
+    int next;                 // index of the next synthetic frame
+    std::vector<int> col_ramp; // 0-255 across the width
+    std::vector<int> row_ramp; // 0-255 down the height
+    cv::Mat noise;            // a band of noise rows, sampled at a per-frame offset
+} frameSource_t;
+
+/*-----------------------------------------------------
+* Function: source_open
+*
+* Description: Opens a video file, camera or "synth:" spec
+*
+* param source: frameSource_t*: output
+* param path: const std::string&: anything VideoCapture opens, or a synth: spec
+*
+* return: bool: false if it couldn't be opened or the spec is malformed
+*--------------------------------------------------------*/
+bool source_open(frameSource_t* source, const std::string& path);
+
+
+/*-----------------------------------------------------
+* Function: source_read
+*
+* Description: Reads the next frame as 8-bit BGR. As with
+* VideoCapture::read, a frame of the right size and type is
+* written in place rather than reallocated.
+*
+* param source: frameSource_t*
+* param frame: cv::Mat&: output
+*
+* return: bool: false at the end of the stream
+*--------------------------------------------------------*/
+bool source_read(frameSource_t* source, cv::Mat& frame);
+
+
+/*-----------------------------------------------------
+* Function: source_grab
+*
+* Description: Skips the next frame without converting it
+*
+* param source: frameSource_t*
+*
+* return: bool: false at the end of the stream
+*--------------------------------------------------------*/
+bool source_grab(frameSource_t* source);
+
+
+/*-----------------------------------------------------
+* Function: source_get
+*
+* Description: VideoCapture::get for CAP_PROP_FRAME_COUNT, CAP_PROP_FPS,
+* CAP_PROP_FRAME_WIDTH and CAP_PROP_FRAME_HEIGHT; other properties
+* are 0 for a synthetic source
+*
+* param source: const frameSource_t*
+* param prop: int: a cv::CAP_PROP_* id
+*
+* return: double
+*--------------------------------------------------------*/
+double source_get(const frameSource_t* source, int prop);
+
+
+/*-----------------------------------------------------
+* Function: source_release
+*
+* Description: Closes the source
+*
+* param source: frameSource_t*
+*
+* return: void
+*--------------------------------------------------------*/
+void source_release(frameSource_t* source);
+
+#endif // _FRAME_SOURCE_HPP
@@ -0,0 +1,387 @@
+/*******************************************************
+* File: metrics.cpp
+*
+* Description: Metric registry, Prometheus text rendering
+* and the HTTP exporter thread
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#include "metrics.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef enum {
+    METRIC_COUNTER,
+    METRIC_GAUGE,
+    METRIC_LATENCY
+} metricType_t;
+
+typedef struct {
+    string name;
+    string labels;
+    string help;
+    metricType_t type;
+    void* metric; // never freed; the hot path may hold it until exit
+} metricEntry_t;
+
+static mutex registry_mutex;
+static vector<metricEntry_t> registry;
+
+static const double quantiles[] = {0.5, 0.9, 0.99};
+
+/*-----------------------------------------------------
+* Function: register_metric
+*
+* Description: Adds a metric to the registry
+*
+* param name, labels, help: const char*: as given to metrics_counter etc.
+* param type: metricType_t
+* param metric: void*: the zeroed metric
+*
+* return: void
+*--------------------------------------------------------*/
+static void register_metric(const char* name, const char* labels, const char* help,
+                            metricType_t type, void* metric) {
+    metricEntry_t entry;
+    entry.name = name;
+    entry.labels = labels;
+    entry.help = help;
+    entry.type = type;
+    entry.metric = metric;
+
+    lock_guard<mutex> lock(registry_mutex);
+    registry.push_back(entry);
+}
+
+metricCounter_t* metrics_counter(const char* name, const char* labels, const char* help,
+                                 double scale) {
+    metricCounter_t* counter = new metricCounter_t();
+    counter->scale = scale;
+    register_metric(name, labels, help, METRIC_COUNTER, counter);
+    return counter;
+}
+
+metricGauge_t* metrics_gauge(const char* name, const char* labels, const char* help) {
+    metricGauge_t* gauge = new metricGauge_t();
+    register_metric(name, labels, help, METRIC_GAUGE, gauge);
+    return gauge;
+}
+
+metricLatency_t* metrics_latency(const char* name, const char* labels, const char* help) {
+    metricLatency_t* latency = new metricLatency_t();
+    register_metric(name, labels, help, METRIC_LATENCY, latency);
+    return latency;
+}
+
+void metrics_observe_ns(metricLatency_t* latency, uint64_t ns) {
+    // The octave comes from the highest set bit and the quarter from the two bits below it,
+    // so no floating point on the hot path
+    uint64_t us = ns / 1000;
+    int bucket = 0;
+    if (us > 0) {
+        int octave = 63 - __builtin_clzll(us);
+        int quarter = (octave >= 2) ? (int)((us >> (octave - 2)) & 3) : (int)((us << (2 - octave)) & 3);
+        bucket = 1 + octave * METRICS_STEPS_PER_OCTAVE + quarter;
+        if (bucket >= METRICS_LATENCY_BUCKETS) {
+            bucket = METRICS_LATENCY_BUCKETS - 1;
+        }
+    }
+    latency->buckets[bucket].fetch_add(1, memory_order_relaxed);
+    latency->sum_ns.fetch_add(ns, memory_order_relaxed);
+    latency->count.fetch_add(1, memory_order_relaxed);
+}
+
+/*-----------------------------------------------------
+* Function: bucket_upper_seconds
+*
+* Description: Upper edge of a latency bucket
+*
+* param bucket: int
+*
+* return: double: seconds
+*--------------------------------------------------------*/
+static double bucket_upper_seconds(int bucket) {
+    if (bucket == 0) {
+        return 1e-6;
+    }
+    int octave = (bucket - 1) / METRICS_STEPS_PER_OCTAVE;
+    int quarter = (bucket - 1) % METRICS_STEPS_PER_OCTAVE;
+    return ldexp(1.0 + (quarter + 1) / (double)METRICS_STEPS_PER_OCTAVE, octave) * 1e-6;
+}
+
+/*-----------------------------------------------------
+* Function: series
+*
+* Description: Formats a sample's name and label set
+*
+* param name: const string&: metric name, with any suffix
+* param labels: const string&: the metric's labels, may be empty
+* param extra: const string&: one more label pair, may be empty
+*
+* return: string: e.g. name{worker="0",quantile="0.5"}
+*--------------------------------------------------------*/
+static string series(const string& name, const string& labels, const string& extra) {
+    if (labels.empty() && extra.empty()) {
+        return name;
+    }
+    string joined = labels;
+    if (!labels.empty() && !extra.empty()) {
+        joined += ",";
+    }
+    joined += extra;
+    return name + "{" + joined + "}";
+}
+
+/*-----------------------------------------------------
+* Function: render_metrics
+*
+* Description: Renders every registered metric in the Prometheus
+* text exposition format, grouped by family
+*
+* return: string
+*--------------------------------------------------------*/
+static string render_metrics() {
+    ostringstream out;
+    out.precision(10);
+
+    lock_guard<mutex> lock(registry_mutex);
+    vector<bool> written(registry.size(), false);
+    for (size_t i = 0; i < registry.size(); i++) {
+        if (written[i]) {
+            continue;
+        }
+        const metricEntry_t& family = registry[i];
+        const char* type = (family.type == METRIC_COUNTER) ? "counter" :
+                           (family.type == METRIC_GAUGE) ? "gauge" : "summary";
+        out << "# HELP " << family.name << " " << family.help << "\n";
+        out << "# TYPE " << family.name << " " << type << "\n";
+
+        for (size_t j = i; j < registry.size(); j++) {
+            const metricEntry_t& entry = registry[j];
+            if (written[j] || entry.name != family.name) {
+                continue;
+            }
+            written[j] = true;
+
+            if (entry.type == METRIC_COUNTER) {
+                const metricCounter_t* counter = (const metricCounter_t*)entry.metric;
+                out << series(entry.name, entry.labels, "") << " "
+                    << counter->value.load(memory_order_relaxed) * counter->scale << "\n";
+            } else if (entry.type == METRIC_GAUGE) {
+                const metricGauge_t* gauge = (const metricGauge_t*)entry.metric;
+                out << series(entry.name, entry.labels, "") << " "
+                    << gauge->value.load(memory_order_relaxed) << "\n";
+            } else {
+                const metricLatency_t* latency = (const metricLatency_t*)entry.metric;
+                // A snapshot taken while samples land can be off by those few samples
+                uint64_t buckets[METRICS_LATENCY_BUCKETS];
+                uint64_t total = 0;
+                for (int b = 0; b < METRICS_LATENCY_BUCKETS; b++) {
+                    buckets[b] = latency->buckets[b].load(memory_order_relaxed);
+                    total += buckets[b];
+                }
+                for (double q : quantiles) {
+                    double value = NAN;
+                    uint64_t seen = 0;
+                    for (int b = 0; b < METRICS_LATENCY_BUCKETS && total > 0; b++) {
+                        seen += buckets[b];
+                        if (buckets[b] > 0 && seen >= q * total) {
+                            value = bucket_upper_seconds(b);
+                            break;
+                        }
+                    }
+                    ostringstream label;
+                    label << "quantile=\"" << q << "\"";
+                    out << series(entry.name, entry.labels, label.str()) << " " << value << "\n";
+                }
+                out << series(entry.name + "_sum", entry.labels, "") << " "
+                    << latency->sum_ns.load(memory_order_relaxed) * 1e-9 << "\n";
+                out << series(entry.name + "_count", entry.labels, "") << " "
+                    << latency->count.load(memory_order_relaxed) << "\n";
+            }
+        }
+    }
+    return out.str();
+}
+
+/*-----------------------------------------------------
+* Function: send_all
+*
+* Description: Writes a whole buffer to a socket, ignoring a
+* client that hung up early
+*
+* param fd: int: connected socket
+* param data: const string&: what to send
+*
+* return: void
+*--------------------------------------------------------*/
+static void send_all(int fd, const string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        sent += n;
+    }
+}
+
+/*-----------------------------------------------------
+* Function: serve_metrics
+*
+* Description: Exporter thread. Answers one request per connection:
+* GET / or /metrics gets the metrics, anything else a 404.
+*
+* param fd: void*: the listening socket, cast to intptr_t
+*
+* return: void*
+*--------------------------------------------------------*/
+static void* serve_metrics(void* fd) {
+    int listen_fd = (int)(intptr_t)fd;
+    while (true) {
+        int client = accept(listen_fd, NULL, NULL);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            cerr << "Metrics: accept failed: " << strerror(errno) << endl;
+            return NULL;
+        }
+
+        // A client that never finishes its request can only stall the exporter for a second
+        struct timeval timeout = {1, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        string request;
+        char buf[1024];
+        while (request.find("\r\n\r\n") == string::npos && request.size() < 8192) {
+            ssize_t n = recv(client, buf, sizeof(buf), 0);
+            if (n <= 0) {
+                break;
+            }
+            request.append(buf, n);
+        }
+
+        string response;
+        if (request.compare(0, 6, "GET / ") == 0 || request.compare(0, 13, "GET /metrics ") == 0 ||
+            request.compare(0, 13, "GET /metrics?") == 0) {
+            string body = render_metrics();
+            response = "HTTP/1.0 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4\r\n"
+                       "Content-Length: " + to_string(body.size()) + "\r\n"
+                       "Connection: close\r\n\r\n" + body;
+        } else {
+            response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        }
+        send_all(client, response);
+        close(client);
+    }
+}
+
+/*-----------------------------------------------------
+* Function: close_listener
+*
+* Description: Closes a listening socket that metrics_serve
+* couldn't finish setting up
+*
+* param fd: int: the socket, or -1 if socket() failed
+*
+* return: void
+*--------------------------------------------------------*/
+static void close_listener(int fd) {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+int metrics_serve(const char* address) {
+    string addr = address;
+    int listen_fd = -1;
+    if (addr.compare(0, 5, "unix:") == 0) {
+        string path = addr.substr(5);
+        struct sockaddr_un sun;
+        memset(&sun, 0, sizeof(sun));
+        sun.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(sun.sun_path)) {
+            cerr << "Metrics: bad socket path: " << path << endl;
+            return -1;
+        }
+        strcpy(sun.sun_path, path.c_str());
+        unlink(path.c_str());
+        listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&sun, sizeof(sun)) != 0) {
+            cerr << "Metrics: cannot bind " << path << ": " << strerror(errno) << endl;
+            close_listener(listen_fd);
+            return -1;
+        }
+    } else {
+        string host = "127.0.0.1";
+        string port = addr;
+        size_t colon = addr.rfind(':');
+        if (colon != string::npos) {
+            host = addr.substr(0, colon);
+            port = addr.substr(colon + 1);
+        }
+        struct sockaddr_in sin;
+        memset(&sin, 0, sizeof(sin));
+        sin.sin_family = AF_INET;
+        sin.sin_port = htons((uint16_t)atoi(port.c_str()));
+        if (inet_pton(AF_INET, host.c_str(), &sin.sin_addr) != 1 || atoi(port.c_str()) <= 0) {
+            cerr << "Metrics: bad address: " << addr << endl;
+            return -1;
+        }
+        listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        int reuse = 1;
+        if (listen_fd >= 0) {
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        if (listen_fd < 0 || bind(listen_fd, (struct sockaddr*)&sin, sizeof(sin)) != 0) {
+            cerr << "Metrics: cannot bind " << addr << ": " << strerror(errno) << endl;
+            close_listener(listen_fd);
+            return -1;
+        }
+    }
+
+    if (listen(listen_fd, 8) != 0) {
+        cerr << "Metrics: listen failed: " << strerror(errno) << endl;
+        close_listener(listen_fd);
+        return -1;
+    }
+
+    // Detached: it blocks in accept() until the process exits
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+    int ret = pthread_create(&thread, &attr, serve_metrics, (void*)(intptr_t)listen_fd);
+    pthread_attr_destroy(&attr);
+    if (ret != 0) {
+        cerr << "Metrics: pthread_create failed: " << ret << endl;
+        close_listener(listen_fd);
+        return -1;
+    }
+    return 0;
+}
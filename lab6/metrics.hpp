@@ -0,0 +1,145 @@
+/*******************************************************
+* File: metrics.hpp
+*
+* Description: Live metrics in Prometheus text format.
+* The processing threads update counters, gauges and
+* latency histograms with relaxed atomics (no locks), and
+* a background thread serves them over HTTP on a TCP port
+* or a Unix socket
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#ifndef _METRICS_HPP
+#define _METRICS_HPP
+
+#include <atomic>
+#include <cstdint>
+
+// Latency buckets: [0, 1 us), then four per octave of microseconds up to ~2^24 us (~16 s)
+#define METRICS_STEPS_PER_OCTAVE 4
+#define METRICS_LATENCY_BUCKETS (24 * METRICS_STEPS_PER_OCTAVE + 1)
+
+typedef struct {
+    std::atomic<uint64_t> value;
+    double scale; // applied on export, e.g. 1e-9 to export nanoseconds as seconds
+} metricCounter_t;
+
+typedef struct {
+    std::atomic<double> value;
+} metricGauge_t;
+
+typedef struct {
+    std::atomic<uint64_t> buckets[METRICS_LATENCY_BUCKETS];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+} metricLatency_t;
+
+/*-----------------------------------------------------
+* Function: metrics_counter
+*
+* Description: Registers a monotonically increasing counter. Metrics
+* sharing a name are exported as one family, told apart by labels.
+* Registration locks; updates never do.
+*
+* param name: const char*: family name, e.g. "edge_frames_total"
+* param labels: const char*: label pairs without braces, e.g. "worker=\"0\"", or ""
+* param help: const char*: HELP text for the family
+* param scale: double: multiplier applied on export
+*
+* return: metricCounter_t*: valid for the rest of the process
+*--------------------------------------------------------*/
+metricCounter_t* metrics_counter(const char* name, const char* labels, const char* help,
+                                 double scale = 1.0);
+
+
+/*-----------------------------------------------------
+* Function: metrics_gauge
+*
+* Description: Registers a gauge, a value that can go up and down
+*
+* param name: const char*: family name
+* param labels: const char*: label pairs without braces, or ""
+* param help: const char*: HELP text for the family
+*
+* return: metricGauge_t*: valid for the rest of the process
+*--------------------------------------------------------*/
+metricGauge_t* metrics_gauge(const char* name, const char* labels, const char* help);
+
+
+/*-----------------------------------------------------
+* Function: metrics_latency
+*
+* Description: Registers a latency histogram, exported as a summary
+* in seconds with 0.5, 0.9 and 0.99 quantiles. Quantiles are the upper
+* edge of their bucket, so up to 25% high.
+*
+* param name: const char*: family name, e.g. "edge_stage_seconds"
+* param labels: const char*: label pairs without braces, or ""
+* param help: const char*: HELP text for the family
+*
+* return: metricLatency_t*: valid for the rest of the process
+*--------------------------------------------------------*/
+metricLatency_t* metrics_latency(const char* name, const char* labels, const char* help);
+
+
+/*-----------------------------------------------------
+* Function: metrics_add
+*
+* Description: Adds to a counter
+*
+* param counter: metricCounter_t*
+* param n: uint64_t: amount to add
+*
+* return: void
+*--------------------------------------------------------*/
+inline void metrics_add(metricCounter_t* counter, uint64_t n) {
+    counter->value.fetch_add(n, std::memory_order_relaxed);
+}
+
+
+/*-----------------------------------------------------
+* Function: metrics_set
+*
+* Description: Sets a gauge
+*
+* param gauge: metricGauge_t*
+* param value: double
+*
+* return: void
+*--------------------------------------------------------*/
+inline void metrics_set(metricGauge_t* gauge, double value) {
+    gauge->value.store(value, std::memory_order_relaxed);
+}
+
+
+/*-----------------------------------------------------
+* Function: metrics_observe_ns
+*
+* Description: Adds one sample to a latency histogram
+*
+* param latency: metricLatency_t*
+* param ns: uint64_t: the sample in nanoseconds
+*
+* return: void
+*--------------------------------------------------------*/
+void metrics_observe_ns(metricLatency_t* latency, uint64_t ns);
+
+
+/*-----------------------------------------------------
+* Function: metrics_serve
+*
+* Description: Starts the background thread answering HTTP GETs with
+* every registered metric. address is "unix:/path/to.sock" for a Unix
+* socket (replaced if it exists) or "[host:]port" for TCP, where host
+* defaults to 127.0.0.1.
+*
+* param address: const char*: where to listen
+*
+* return: int: 0 on success, -1 if the socket couldn't be set up
+*--------------------------------------------------------*/
+int metrics_serve(const char* address);
+
+#endif // _METRICS_HPP
@@ -17,6 +17,40 @@
 using namespace cv;
 using namespace std;
 
+// bytes in a cache line, the granularity software prefetches are issued at
+#define CACHE_LINE 64
+
+// memory hints shared by all workers, set once before the threads start
+static int prefetch_rows = 0;
+static bool stream_stores = false;
+
+void to442_set_mem_hints(int rows, bool stream) {
+    prefetch_rows = rows;
+    stream_stores = stream;
+}
+
+/*-----------------------------------------------------
+* Function: store_stream_u8x16
+*
+* Description: Stores two 8 byte vectors to 16 consecutive bytes with a
+* non-temporal store pair so the line isn't kept in cache. Falls back to
+* normal stores where STNP isn't available.
+*
+* param dst: uint8_t*: destination
+* param lo: uint8x8_t: bytes 0-7
+* param hi: uint8x8_t: bytes 8-15
+*
+* return: void
+*--------------------------------------------------------*/
+static inline void store_stream_u8x16(uint8_t* dst, uint8x8_t lo, uint8x8_t hi) {
+#if defined(__aarch64__)
+    asm volatile("stnp %d0, %d1, [%2]" : : "w"(lo), "w"(hi), "r"(dst) : "memory");
+#else
+    vst1_u8(dst, lo);
+    vst1_u8(dst+8, hi);
+#endif
+}
+
 /*-----------------------------------------------------
 * Function: to442_grayscale
 *
@@ -41,10 +75,22 @@ void to442_grayscale(Mat* source, Mat *output,
         uchar* source_pointer = source->ptr<uchar>(row) + 3 * col_size;
         uchar* output_pointer = output->ptr<uchar>(row) + col_size;
 
+        // the BGR source is only read once, so prefetch it as streaming data
+        const uchar* prefetch_pointer = NULL;
+        if (prefetch_rows > 0 && row + prefetch_rows < source->rows) {
+            prefetch_pointer = source->ptr<uchar>(row + prefetch_rows) + 3 * col_size;
+        }
+        int next_prefetch = 0;
+
         int col = 0;
 
         for(; col <= w - 16; col += 16)
         {
+            if (prefetch_pointer && 3 * col >= next_prefetch) {
+                __builtin_prefetch(prefetch_pointer + next_prefetch, 0, 0);
+                next_prefetch += CACHE_LINE;
+            }
+
             uint8x16x3_t bgr = vld3q_u8(source_pointer);
 
             uint16x8_t b_lo = vmovl_u8(vget_low_u8(bgr.val[0]));
@@ -85,6 +131,44 @@ void to442_grayscale(Mat* source, Mat *output,
 }
 
 
+/*-----------------------------------------------------
+* Function: sobel_u8x8
+*
+* Description: Computes the saturated |Gx| + |Gy| Sobel magnitude of 8
+* consecutive pixels
+*
+* param rows: const uint8_t* const[3]: the rows above, at and below the pixels
+* param col: int: column of the first of the 8 pixels
+*
+* return: uint8x8_t: the 8 magnitudes
+*--------------------------------------------------------*/
+static inline uint8x8_t sobel_u8x8(const uint8_t* const rows[3], int col) {
+    static const int16_t G_x[3][3] = GX;
+    static const int16_t G_y[3][3] = GY;
+    // For each pixel, convolute the 3x3 matrices GX and GY
+    int16x8_t G_x_sum = vdupq_n_s16(0);
+    int16x8_t G_y_sum = vdupq_n_s16(0);
+    for (int i = -1; i <= 1; i++) {
+        for (int j =-1; j <= 1; j++) {
+            uint8x8_t pixs = vld1_u8(rows[i+1]+col+j);
+            uint16x8_t pixs_intermed_u = vmovl_u8(pixs);
+            int16x8_t pixs_intermed_s = vreinterpretq_s16_u16(pixs_intermed_u);
+
+            int16x8_t conv_prod_x = vmulq_n_s16(pixs_intermed_s, G_x[i+1][j+1]);
+            int16x8_t conv_prod_y = vmulq_n_s16(pixs_intermed_s, G_y[i+1][j+1]);
+            
+            G_x_sum = vaddq_s16(G_x_sum, conv_prod_x);
+            G_y_sum = vaddq_s16(G_y_sum, conv_prod_y);
+        }
+    }
+    int16x8_t G_x_sum_abs = vabsq_s16(G_x_sum);
+    int16x8_t G_y_sum_abs = vabsq_s16(G_y_sum);
+
+    int16x8_t G_16 = vaddq_s16(G_x_sum_abs, G_y_sum_abs);
+    
+    return vqmovun_s16(G_16);
+}
+
 /*-----------------------------------------------------
 * Function: to442_sobel
 *
@@ -100,38 +184,70 @@ void to442_grayscale(Mat* source, Mat *output,
 * return: void
 *--------------------------------------------------------*/
 void to442_sobel(Mat* src, Mat* dst, int r0, int c0, int h, int w) {
-    int16_t G_x[3][3] = GX;
-    int16_t G_y[3][3] = GY;
-    uint8_t* rowPtr;
     // loop through all pixels except the outermost pixel border
     for (int row = r0+1; row < r0+h-1; row++) {
-        for (int col = c0+1; col <= c0+w-9; col += 8) {
-            // For each pixel, convolute the 3x3 matrices GX and GY
-            int16x8_t G_x_sum = vdupq_n_s16(0);
-            int16x8_t G_y_sum = vdupq_n_s16(0);
-            for (int i = -1; i <= 1; i++) {
-                rowPtr = (*src).ptr<uint8_t>(row+i);
-                for (int j =-1; j <= 1; j++) {
-                    uint8x8_t pixs = vld1_u8(rowPtr+col+j);
-                    uint16x8_t pixs_intermed_u = vmovl_u8(pixs);
-                    int16x8_t pixs_intermed_s = vreinterpretq_s16_u16(pixs_intermed_u);
-
-                    int16x8_t conv_prod_x = vmulq_n_s16(pixs_intermed_s, G_x[i+1][j+1]);
-                    int16x8_t conv_prod_y = vmulq_n_s16(pixs_intermed_s, G_y[i+1][j+1]);
-                    
-                    G_x_sum = vaddq_s16(G_x_sum, conv_prod_x);
-                    G_y_sum = vaddq_s16(G_y_sum, conv_prod_y);
+        const uint8_t* rows[3] = {
+            (*src).ptr<uint8_t>(row-1),
+            (*src).ptr<uint8_t>(row),
+            (*src).ptr<uint8_t>(row+1)
+        };
+        uint8_t* rowPtr_dst = (*dst).ptr<uint8_t>(row-1);
+
+        // gray rows are reused by the next two output rows, so keep them in cache
+        const uint8_t* prefetch_ptr = NULL;
+        if (prefetch_rows > 0 && row + 1 + prefetch_rows < src->rows) {
+            prefetch_ptr = (*src).ptr<uint8_t>(row + 1 + prefetch_rows);
+        }
+        int next_prefetch = c0;
+
+        int col = c0+1;
+        if (stream_stores) {
+            for (; col <= c0+w-17; col += 16) {
+                if (prefetch_ptr && col >= next_prefetch) {
+                    __builtin_prefetch(prefetch_ptr + next_prefetch, 0, 3);
+                    next_prefetch += CACHE_LINE;
                 }
+                uint8x8_t G_lo = sobel_u8x8(rows, col);
+                uint8x8_t G_hi = sobel_u8x8(rows, col+8);
+                store_stream_u8x16(rowPtr_dst+col-1, G_lo, G_hi);
+            }
+        }
+        for (; col <= c0+w-9; col += 8) {
+            if (prefetch_ptr && col >= next_prefetch) {
+                __builtin_prefetch(prefetch_ptr + next_prefetch, 0, 3);
+                next_prefetch += CACHE_LINE;
             }
-            int16x8_t G_x_sum_abs = vabsq_s16(G_x_sum);
-            int16x8_t G_y_sum_abs = vabsq_s16(G_y_sum);
+            vst1_u8(rowPtr_dst+col-1, sobel_u8x8(rows, col));
+        }
+    }
+}
 
-            int16x8_t G_16 = vaddq_s16(G_x_sum_abs, G_y_sum_abs);
-            
-            uint8x8_t G_8 = vqmovun_s16(G_16);
 
-            uint8_t* rowPtr_dst = (*dst).ptr<uint8_t>(row-1);
-            vst1_u8(rowPtr_dst+col-1, G_8);
-        }
+void to442_edge_strips(Mat* src, Mat* scratch, Mat* dst, int r0, int c0, int h, int w, int strip_rows) {
+    if (scratch->rows < strip_rows + 2 || scratch->cols < src->cols) {
+        scratch->create(strip_rows + 2, src->cols, CV_8UC1);
+    }
+    int end = r0 + h; // one past the last input row of the band
+    for (int row = r0; row + 2 < end; row += strip_rows) {
+        // the strip's output rows plus the two rows below them that Sobel also reads
+        int strip_h = min(strip_rows + 2, end - row);
+        // row-offset headers, so the kernels' row 0 is the strip's first row; the source
+        // header runs to the end of the band so prefetching still looks ahead
+        Mat strip_src = src->rowRange(row, end);
+        Mat strip_gray = scratch->rowRange(0, strip_h);
+        Mat strip_dst = dst->rowRange(row, row + strip_h - 2);
+        to442_grayscale(&strip_src, &strip_gray, 0, c0, strip_h, w);
+        to442_sobel(&strip_gray, &strip_dst, 0, c0, strip_h, w);
+    }
+}
+
+
+void to442_split_rows(threadArgs_t* args, int num_threads, Mat* src, Mat* gray, Mat* sobel) {
+    int height = gray->rows;
+    int sub_h = height / num_threads;
+    for (int i = 0; i < num_threads; i++) {
+        int first = (i == 0) ? 0 : i*sub_h - 1;
+        int end = (i == num_threads-1) ? height : (i+1)*sub_h + 1;
+        args[i] = threadArgs_t{src, gray, sobel, first, 0, end - first, gray->cols, i, -1, 0, 0, 0, 0, 0, 0};
     }
 }
@@ -34,6 +34,7 @@ typedef struct {
     int h;
     int w;
     int thread_id;
+    int cpu;
 	long long l1_data_cache_misses;
 	long long l1_instr_cache_misses;
 	long long l2_data_cache_misses;
@@ -77,4 +78,64 @@ void to442_grayscale(Mat* src, Mat* dst, int r0, int c0, int h, int w);
 void to442_sobel(Mat* src, Mat* dst, int r0, int c0, int h, int w);
 
 
+/*-----------------------------------------------------
+* Function: to442_split_rows
+*
+* Description: Splits a frame into one horizontal band per worker.
+* Neighbouring bands overlap by the two rows Sobel reads across the
+* edge; the last band also takes the rows left over by the division.
+* Sets each band's rows, columns and thread_id; the caller fills in cpu.
+*
+* param args: threadArgs_t*: output, one per worker
+* param num_threads: int: number of workers, at most gray->rows so every
+* band has a row of its own
+* param src: Mat*: the input color image
+* param gray: Mat*: the grayscale image
+* param sobel: Mat*: the output edge-detected image
+*
+* return: void
+*--------------------------------------------------------*/ 
+void to442_split_rows(threadArgs_t* args, int num_threads, Mat* src, Mat* gray, Mat* sobel);
+
+
+/*-----------------------------------------------------
+* Function: to442_edge_strips
+*
+* Description: Grayscales and Sobel filters a band of rows in strips,
+* so each strip's gray rows are still in cache when Sobel reads them.
+* Gray goes to a scratch buffer private to the calling thread, and each
+* strip converts its own two halo rows again, so no other thread writes
+* what it reads and no barrier is needed between the passes.
+*
+* param src: Mat*: the input color image
+* param scratch: Mat*: the calling thread's gray scratch, (re)allocated
+* here to strip_rows + 2 rows if it's smaller
+* param dst: Mat*: the output edge-detected image
+* param r0: int: the starting row index
+* param c0: int: the starting column index
+* param h: int: the height of the processing region, as for to442_grayscale
+* param w: int: the width of the processing region
+* param strip_rows: int: output rows per strip
+*
+* return: void
+*--------------------------------------------------------*/ 
+void to442_edge_strips(Mat* src, Mat* scratch, Mat* dst, int r0, int c0, int h, int w, int strip_rows);
+
+
+/*-----------------------------------------------------
+* Function: to442_set_mem_hints
+*
+* Description: Configures the memory hints used by to442_grayscale and
+* to442_sobel. Call before starting the worker threads.
+*
+* param prefetch_rows: int: how many rows ahead of the current row to
+* software prefetch (0 disables prefetching)
+* param stream_stores: bool: write the Sobel output with non-temporal
+* stores so it doesn't evict the rows still being read (AArch64 only)
+*
+* return: void
+*--------------------------------------------------------*/ 
+void to442_set_mem_hints(int prefetch_rows, bool stream_stores);
+
+
 #endif // _PROCESSING_HPP
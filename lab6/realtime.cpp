@@ -0,0 +1,118 @@
+/*******************************************************
+* File: realtime.cpp
+*
+* Description: Deadline scheduler for real-time playback
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#include "realtime.hpp"
+#include <time.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+// weight of a faster frame in the full resolution frame time estimate
+#define RT_SMOOTHING 0.2
+// per degraded frame, so full resolution is retried after a run of degraded frames
+#define RT_RETRY_DECAY 0.97
+
+bool rt_parse_policy(const char* name, rtPolicy_t* policy) {
+    if (strcmp(name, "off") == 0) {
+        *policy = RT_OFF;
+    } else if (strcmp(name, "drop") == 0) {
+        *policy = RT_DROP;
+    } else if (strcmp(name, "degrade") == 0) {
+        *policy = RT_DEGRADE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void rt_init(rtScheduler_t* rt, rtPolicy_t policy, double fps) {
+    memset(rt, 0, sizeof(*rt));
+    rt->policy = policy;
+    rt->period_ns = (uint64_t)(1e9 / (fps > 0 ? fps : 30.0));
+}
+
+/*-----------------------------------------------------
+* Function: deadline_ns
+*
+* Description: Latest time a frame can be shown, when the next is released
+*
+* param rt: const rtScheduler_t*
+* param frame: int: frame index
+*
+* return: uint64_t
+*--------------------------------------------------------*/
+static uint64_t deadline_ns(const rtScheduler_t* rt, int frame) {
+    return rt->start_ns + (uint64_t)(frame + 1) * rt->period_ns;
+}
+
+uint64_t rt_wait_release(rtScheduler_t* rt, int frame, uint64_t now_ns) {
+    if (rt->policy == RT_OFF) {
+        return now_ns;
+    }
+    if (rt->start_ns == 0) {
+        rt->start_ns = now_ns - (uint64_t)frame * rt->period_ns;
+        return now_ns;
+    }
+    uint64_t release = rt->start_ns + (uint64_t)frame * rt->period_ns;
+    if (now_ns >= release) {
+        return now_ns;
+    }
+    // steady_clock is CLOCK_MONOTONIC on Linux, so sleep to the absolute release time
+    struct timespec until;
+    until.tv_sec = release / 1000000000ULL;
+    until.tv_nsec = release % 1000000000ULL;
+    // returns the error rather than setting errno; only a signal is worth retrying
+    int ret;
+    while ((ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL)) == EINTR) {
+    }
+    if (ret != 0) {
+        fprintf(stderr, "rt_wait_release: clock_nanosleep failed: %s\n", strerror(ret));
+        return now_ns;
+    }
+    return release;
+}
+
+rtDecision_t rt_decide(rtScheduler_t* rt, int frame, uint64_t now_ns) {
+    if (rt->policy == RT_OFF) {
+        return RT_FULL;
+    }
+    uint64_t deadline = deadline_ns(rt, frame);
+    if (now_ns >= deadline) {
+        rt->dropped_stale++;
+        return RT_SKIP;
+    }
+    if (rt->policy == RT_DEGRADE && now_ns + rt->full_ns > deadline) {
+        rt->degraded_overrun++;
+        return RT_HALF;
+    }
+    return RT_FULL;
+}
+
+void rt_finished(rtScheduler_t* rt, int frame, rtDecision_t decision,
+                 uint64_t start_ns, uint64_t shown_ns) {
+    rt->processed++;
+    if (rt->policy != RT_OFF && shown_ns > deadline_ns(rt, frame)) {
+        rt->late++;
+    }
+
+    // While degraded nothing measures full resolution, so its estimate decays until a full
+    // frame is tried again; if the load hasn't eased, that frame's time pushes it back up
+    if (decision == RT_HALF) {
+        rt->full_ns *= RT_RETRY_DECAY;
+        return;
+    }
+    // Pessimistic: a slower frame is believed at once, faster ones only gradually
+    double took = (double)(shown_ns - start_ns);
+    if (took > rt->full_ns) {
+        rt->full_ns = took;
+    } else {
+        rt->full_ns = (1 - RT_SMOOTHING) * rt->full_ns + RT_SMOOTHING * took;
+    }
+}
@@ -0,0 +1,122 @@
+/*******************************************************
+* File: realtime.hpp
+*
+* Description: Deadline scheduler for real-time playback.
+* Frames are released at the source frame rate and must be
+* shown before the next one arrives; when the pipeline falls
+* behind, stale frames are dropped and frames predicted to
+* miss are processed at half resolution
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#ifndef _REALTIME_HPP
+#define _REALTIME_HPP
+
+#include <cstdint>
+
+typedef enum {
+    RT_OFF,     // process every frame as fast as possible (the default)
+    RT_DROP,    // pace to the source and drop stale frames
+    RT_DEGRADE  // as RT_DROP, and use half resolution when full would miss the deadline
+} rtPolicy_t;
+
+typedef enum {
+    RT_FULL,  // process at full resolution
+    RT_HALF,  // process at half resolution
+    RT_SKIP   // drop the frame; a newer one is already due
+} rtDecision_t;
+
+typedef struct {
+    rtPolicy_t policy;
+    uint64_t period_ns;   // 1 / source FPS
+    uint64_t start_ns;    // release time of frame 0, 0 until the first frame
+    double full_ns;       // recent full resolution frame time, 0 until measured
+    int processed;
+    int dropped_stale;    // skipped because the next frame was already due
+    int degraded_overrun; // half resolution because full was predicted to miss
+    int late;             // processed but shown after the deadline
+} rtScheduler_t;
+
+/*-----------------------------------------------------
+* Function: rt_parse_policy
+*
+* Description: Parses a --realtime argument
+*
+* param name: const char*: "off", "drop" or "degrade"
+* param policy: rtPolicy_t*: output
+*
+* return: bool: false if the name isn't recognised
+*--------------------------------------------------------*/
+bool rt_parse_policy(const char* name, rtPolicy_t* policy);
+
+
+/*-----------------------------------------------------
+* Function: rt_init
+*
+* Description: Sets up the scheduler for a source frame rate
+*
+* param rt: rtScheduler_t*: output
+* param policy: rtPolicy_t
+* param fps: double: source frame rate; 30 is assumed if it's unknown (<= 0)
+*
+* return: void
+*--------------------------------------------------------*/
+void rt_init(rtScheduler_t* rt, rtPolicy_t policy, double fps);
+
+
+/*-----------------------------------------------------
+* Function: rt_wait_release
+*
+* Description: Sleeps until a frame's release time, so a file plays
+* back like a live source. Returns at once with RT_OFF or when the
+* frame is already due; the first call starts the clock. If the sleep
+* fails for any reason but a signal, the error is reported and it
+* returns without waiting.
+*
+* param rt: rtScheduler_t*
+* param frame: int: frame index
+* param now_ns: uint64_t: steady_clock time in nanoseconds
+*
+* return: uint64_t: the time after waiting
+*--------------------------------------------------------*/
+uint64_t rt_wait_release(rtScheduler_t* rt, int frame, uint64_t now_ns);
+
+
+/*-----------------------------------------------------
+* Function: rt_decide
+*
+* Description: Decides how to handle a released frame. A frame is
+* stale once the next frame's release time has passed (its deadline);
+* with RT_DEGRADE a frame whose full resolution time would overrun
+* the deadline is processed at half resolution instead.
+*
+* param rt: rtScheduler_t*
+* param frame: int: frame index
+* param now_ns: uint64_t: steady_clock time in nanoseconds
+*
+* return: rtDecision_t
+*--------------------------------------------------------*/
+rtDecision_t rt_decide(rtScheduler_t* rt, int frame, uint64_t now_ns);
+
+
+/*-----------------------------------------------------
+* Function: rt_finished
+*
+* Description: Records how long a processed frame took and whether it
+* made its deadline, to predict the following frames
+*
+* param rt: rtScheduler_t*
+* param frame: int: frame index
+* param decision: rtDecision_t: how it was processed (RT_FULL or RT_HALF)
+* param start_ns: uint64_t: when rt_decide was called for it
+* param shown_ns: uint64_t: when it was shown
+*
+* return: void
+*--------------------------------------------------------*/
+void rt_finished(rtScheduler_t* rt, int frame, rtDecision_t decision,
+                 uint64_t start_ns, uint64_t shown_ns);
+
+#endif // _REALTIME_HPP
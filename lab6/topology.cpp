@@ -0,0 +1,218 @@
+/*******************************************************
+* File: topology.cpp
+*
+* Description: CPU/NUMA topology discovery and worker
+* thread placement read from /sys/devices/system/cpu
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#include "topology.hpp"
+#include <sched.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+using namespace std;
+
+#define SYSFS_CPU "/sys/devices/system/cpu/"
+
+/*-----------------------------------------------------
+* Function: read_int_file
+*
+* Description: Reads a single integer from a sysfs file
+*
+* param path: const string&: file to read
+* param fallback: int: value returned if the file can't be read
+*
+* return: int
+*--------------------------------------------------------*/
+static int read_int_file(const string& path, int fallback) {
+    ifstream file(path);
+    int value;
+    if (file >> value) {
+        return value;
+    }
+    return fallback;
+}
+
+/*-----------------------------------------------------
+* Function: parse_cpu_list
+*
+* Description: Parses a kernel cpulist string such as "0-3,8,10-11"
+*
+* param list: const string&: the cpulist
+*
+* return: vector<int>: the expanded CPU numbers
+*--------------------------------------------------------*/
+static vector<int> parse_cpu_list(const string& list) {
+    vector<int> cpus;
+    stringstream ss(list);
+    string range;
+    while (getline(ss, range, ',')) {
+        if (range.empty() || range == "\n") {
+            continue;
+        }
+        size_t dash = range.find('-');
+        int lo = atoi(range.c_str());
+        int hi = (dash == string::npos) ? lo : atoi(range.c_str() + dash + 1);
+        for (int cpu = lo; cpu <= hi; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+/*-----------------------------------------------------
+* Function: cpu_node
+*
+* Description: Finds the NUMA node of a CPU from the nodeN link
+* in its sysfs directory
+*
+* param cpu: int: logical CPU number
+*
+* return: int: the node, or 0 on non-NUMA kernels
+*--------------------------------------------------------*/
+static int cpu_node(int cpu) {
+    string dir_path = SYSFS_CPU "cpu" + to_string(cpu);
+    DIR* dir = opendir(dir_path.c_str());
+    if (!dir) {
+        return 0;
+    }
+    int node = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+vector<cpuInfo_t> read_cpu_topology() {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, &allowed);
+        }
+    }
+
+    vector<int> online;
+    ifstream online_file(SYSFS_CPU "online");
+    string online_list;
+    if (getline(online_file, online_list)) {
+        online = parse_cpu_list(online_list);
+    } else {
+        long count = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int cpu = 0; cpu < count; cpu++) {
+            online.push_back(cpu);
+        }
+    }
+
+    vector<cpuInfo_t> cpus;
+    for (int cpu : online) {
+        if (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed)) {
+            continue;
+        }
+        string topo = SYSFS_CPU "cpu" + to_string(cpu) + "/topology/";
+        cpuInfo_t info;
+        info.cpu = cpu;
+        info.package_id = read_int_file(topo + "physical_package_id", 0);
+        info.core_id = read_int_file(topo + "core_id", cpu);
+        info.node = cpu_node(cpu);
+        info.smt_rank = 0;
+        cpus.push_back(info);
+    }
+
+    // rank hardware threads within each physical core by CPU number
+    map<pair<int, int>, int> threads_seen;
+    for (cpuInfo_t& info : cpus) {
+        info.smt_rank = threads_seen[make_pair(info.package_id, info.core_id)]++;
+    }
+    return cpus;
+}
+
+vector<cpuInfo_t> pick_worker_cpus(const vector<cpuInfo_t>& cpus, int num_workers, int* node) {
+    // pick the node with the most physical cores (lowest node number on ties)
+    map<int, int> cores_per_node;
+    for (const cpuInfo_t& info : cpus) {
+        if (info.smt_rank == 0) {
+            cores_per_node[info.node]++;
+        }
+    }
+    int best_node = cpus.empty() ? 0 : cpus[0].node;
+    int best_cores = -1;
+    for (const auto& entry : cores_per_node) {
+        if (entry.second > best_cores) {
+            best_node = entry.first;
+            best_cores = entry.second;
+        }
+    }
+    *node = best_node;
+
+    // chosen node first, then physical cores before SMT siblings, then package/core order
+    vector<cpuInfo_t> order(cpus);
+    stable_sort(order.begin(), order.end(), [best_node](const cpuInfo_t& a, const cpuInfo_t& b) {
+        bool a_local = a.node == best_node;
+        bool b_local = b.node == best_node;
+        if (a_local != b_local) {
+            return a_local;
+        }
+        if (a.smt_rank != b.smt_rank) {
+            return a.smt_rank < b.smt_rank;
+        }
+        if (a.package_id != b.package_id) {
+            return a.package_id < b.package_id;
+        }
+        return a.core_id < b.core_id;
+    });
+
+    vector<cpuInfo_t> placement;
+    for (int i = 0; i < num_workers; i++) {
+        if (order.empty()) {
+            cpuInfo_t info = {i, 0, i, 0, 0};
+            placement.push_back(info);
+        } else {
+            // more workers than CPUs wraps around and shares CPUs
+            placement.push_back(order[i % order.size()]);
+        }
+    }
+    return placement;
+}
+
+int pin_thread_to_cpus(pthread_t thread, const vector<int>& cpus) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &cpuset);
+    }
+    return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset);
+}
+
+vector<int> node_cpus(const vector<cpuInfo_t>& cpus, int node) {
+    vector<int> result;
+    for (const cpuInfo_t& info : cpus) {
+        if (info.node == node) {
+            result.push_back(info.cpu);
+        }
+    }
+    return result;
+}
+
+string describe_cpu(const cpuInfo_t& info) {
+    return "CPU " + to_string(info.cpu) +
+           " (package " + to_string(info.package_id) +
+           ", core " + to_string(info.core_id) +
+           ", node " + to_string(info.node) +
+           ", smt " + to_string(info.smt_rank) + ")";
+}
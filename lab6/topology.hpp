@@ -0,0 +1,94 @@
+/*******************************************************
+* File: topology.hpp
+*
+* Description: CPU/NUMA topology discovery and worker
+* thread placement read from /sys/devices/system/cpu
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#ifndef _TOPOLOGY_HPP
+#define _TOPOLOGY_HPP
+
+#include <pthread.h>
+#include <string>
+#include <vector>
+
+typedef struct {
+    int cpu;        // logical CPU number
+    int package_id; // physical socket
+    int core_id;    // physical core within the socket
+    int node;       // NUMA node the CPU belongs to
+    int smt_rank;   // 0 for the first hardware thread of a core, 1+ for its siblings
+} cpuInfo_t;
+
+/*-----------------------------------------------------
+* Function: read_cpu_topology
+*
+* Description: Reads the package, core, NUMA node and SMT rank of
+* every online CPU this process is allowed to run on. Falls back to
+* a flat single-node layout if sysfs is unavailable.
+*
+* return: std::vector<cpuInfo_t>: one entry per usable CPU, sorted by cpu
+*--------------------------------------------------------*/
+std::vector<cpuInfo_t> read_cpu_topology();
+
+
+/*-----------------------------------------------------
+* Function: pick_worker_cpus
+*
+* Description: Chooses a CPU for each worker. All workers are kept on
+* the NUMA node with the most physical cores, one worker per physical
+* core first, and only then on SMT siblings or other nodes.
+*
+* param cpus: const std::vector<cpuInfo_t>&: topology from read_cpu_topology
+* param num_workers: int: number of worker threads to place
+* param node: int*: output, the NUMA node the workers were placed on
+*
+* return: std::vector<cpuInfo_t>: placement for worker 0..num_workers-1
+*--------------------------------------------------------*/
+std::vector<cpuInfo_t> pick_worker_cpus(const std::vector<cpuInfo_t>& cpus,
+                                        int num_workers, int* node);
+
+
+/*-----------------------------------------------------
+* Function: pin_thread_to_cpus
+*
+* Description: Restricts a thread to the given set of CPUs
+*
+* param thread: pthread_t: the thread to pin
+* param cpus: const std::vector<int>&: logical CPU numbers to allow
+*
+* return: int: 0 on success, otherwise the pthread_setaffinity_np error
+*--------------------------------------------------------*/
+int pin_thread_to_cpus(pthread_t thread, const std::vector<int>& cpus);
+
+
+/*-----------------------------------------------------
+* Function: node_cpus
+*
+* Description: Lists the logical CPUs of a NUMA node
+*
+* param cpus: const std::vector<cpuInfo_t>&: topology from read_cpu_topology
+* param node: int: the NUMA node
+*
+* return: std::vector<int>: logical CPU numbers on that node
+*--------------------------------------------------------*/
+std::vector<int> node_cpus(const std::vector<cpuInfo_t>& cpus, int node);
+
+
+/*-----------------------------------------------------
+* Function: describe_cpu
+*
+* Description: Formats a placement for logging,
+* e.g. "CPU 2 (package 0, core 2, node 0, smt 0)"
+*
+* param info: const cpuInfo_t&: the CPU to describe
+*
+* return: std::string
+*--------------------------------------------------------*/
+std::string describe_cpu(const cpuInfo_t& info);
+
+#endif // _TOPOLOGY_HPP
@@ -0,0 +1,179 @@
+/*******************************************************
+* File: trace.cpp
+*
+* Description: Per-thread ring buffers of pipeline spans and
+* the Chrome trace-event JSON writer for them
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#include "trace.hpp"
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+typedef struct {
+    vector<traceEvent_t> events; // ring, written only by its own thread
+    uint64_t recorded;           // total spans recorded; events[recorded % size] is next
+    int tid;
+    string name;
+} traceBuffer_t;
+
+// Buffers outlive their threads so workers that have already exited still get written out
+static mutex buffers_mutex;
+static vector<unique_ptr<traceBuffer_t>> buffers;
+static atomic<bool> enabled(false);
+static size_t capacity = 0;
+static thread_local traceBuffer_t* local_buffer = NULL;
+
+/*-----------------------------------------------------
+* Function: thread_buffer
+*
+* Description: Returns the calling thread's buffer, registering
+* one the first time the thread records. Only this first call locks.
+*
+* return: traceBuffer_t*
+*--------------------------------------------------------*/
+static traceBuffer_t* thread_buffer() {
+    if (local_buffer == NULL) {
+        unique_ptr<traceBuffer_t> buffer(new traceBuffer_t);
+        buffer->events.resize(capacity);
+        buffer->recorded = 0;
+        buffer->tid = (int)syscall(SYS_gettid);
+
+        lock_guard<mutex> lock(buffers_mutex);
+        local_buffer = buffer.get();
+        buffers.push_back(move(buffer));
+    }
+    return local_buffer;
+}
+
+void trace_enable(size_t events_per_thread) {
+    capacity = (events_per_thread > 0) ? events_per_thread : 1;
+    enabled.store(true, memory_order_release);
+}
+
+bool trace_enabled() {
+    return enabled.load(memory_order_relaxed);
+}
+
+uint64_t trace_now_ns() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void trace_thread_name(const char* name) {
+    if (!trace_enabled()) {
+        return;
+    }
+    thread_buffer()->name = name;
+}
+
+uint64_t trace_span(const char* name, uint64_t start_ns, int frame) {
+    uint64_t end_ns = trace_now_ns();
+    if (!trace_enabled()) {
+        return end_ns;
+    }
+    traceBuffer_t* buffer = thread_buffer();
+    traceEvent_t& event = buffer->events[buffer->recorded % buffer->events.size()];
+    event.name = name;
+    event.start_ns = start_ns;
+    event.dur_ns = end_ns - start_ns;
+    event.frame = frame;
+    buffer->recorded++;
+    return end_ns;
+}
+
+/*-----------------------------------------------------
+* Function: write_escaped
+*
+* Description: Writes a JSON string literal, escaping quotes,
+* backslashes and control characters
+*
+* param file: FILE*: output file
+* param text: const char*: the string
+*
+* return: void
+*--------------------------------------------------------*/
+static void write_escaped(FILE* file, const char* text) {
+    fputc('"', file);
+    for (const char* c = text; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(file, "\\%c", *c);
+        } else if ((unsigned char)*c < 0x20) {
+            fprintf(file, "\\u%04x", (unsigned char)*c);
+        } else {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+int trace_write_json(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        return -1;
+    }
+
+    lock_guard<mutex> lock(buffers_mutex);
+
+    // Timestamps are relative to the earliest surviving span so the timeline starts at 0
+    uint64_t origin = UINT64_MAX;
+    for (const unique_ptr<traceBuffer_t>& buffer : buffers) {
+        size_t size = buffer->events.size();
+        uint64_t first = (buffer->recorded > size) ? buffer->recorded - size : 0;
+        for (uint64_t i = first; i < buffer->recorded; i++) {
+            if (buffer->events[i % size].start_ns < origin) {
+                origin = buffer->events[i % size].start_ns;
+            }
+        }
+    }
+
+    int written = 0;
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for (const unique_ptr<traceBuffer_t>& buffer : buffers) {
+        if (!buffer->name.empty()) {
+            fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":",
+                    written > 0 ? ",\n" : "", buffer->tid);
+            write_escaped(file, buffer->name.c_str());
+            fprintf(file, "}}");
+            written++;
+        }
+
+        size_t size = buffer->events.size();
+        uint64_t first = (buffer->recorded > size) ? buffer->recorded - size : 0;
+        if (first > 0) {
+            fprintf(stderr, "Trace: thread %d overflowed, oldest %llu spans dropped\n",
+                    buffer->tid, (unsigned long long)first);
+        }
+        for (uint64_t i = first; i < buffer->recorded; i++) {
+            const traceEvent_t& event = buffer->events[i % size];
+            // ts and dur are in microseconds; keep the nanoseconds as fractions
+            fprintf(file, "%s{\"name\":", written > 0 ? ",\n" : "");
+            write_escaped(file, event.name);
+            fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+                    buffer->tid, (event.start_ns - origin) / 1000.0, event.dur_ns / 1000.0);
+            if (event.frame >= 0) {
+                fprintf(file, ",\"args\":{\"frame\":%d}", event.frame);
+            }
+            fprintf(file, "}");
+            written++;
+        }
+    }
+    fprintf(file, "\n]}\n");
+
+    if (fclose(file) != 0) {
+        return -1;
+    }
+    return written;
+}
@@ -0,0 +1,101 @@
+/*******************************************************
+* File: trace.hpp
+*
+* Description: Low-overhead span recorder that dumps a
+* Chrome trace-event JSON file (open it in Perfetto or
+* chrome://tracing) showing what every thread did per frame
+*
+* Author: Logan Schmid, Enrique Murillo
+*
+* Revision history
+*
+********************************************************/
+#ifndef _TRACE_HPP
+#define _TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+typedef struct {
+    const char* name;  // string literal, never copied
+    uint64_t start_ns; // steady_clock time the span started
+    uint64_t dur_ns;
+    int frame;         // frame index, -1 if not tied to a frame
+} traceEvent_t;
+
+/*-----------------------------------------------------
+* Function: trace_enable
+*
+* Description: Turns recording on. Every thread that records gets
+* its own ring buffer of this many events, so recording never takes
+* a lock; once full, the oldest events are overwritten.
+* Call before starting the threads that record.
+*
+* param events_per_thread: size_t: ring buffer capacity per thread
+*
+* return: void
+*--------------------------------------------------------*/
+void trace_enable(size_t events_per_thread);
+
+
+/*-----------------------------------------------------
+* Function: trace_enabled
+*
+* Description: Whether trace_enable has been called
+*
+* return: bool
+*--------------------------------------------------------*/
+bool trace_enabled();
+
+
+/*-----------------------------------------------------
+* Function: trace_now_ns
+*
+* Description: Reads the clock spans are stamped with
+*
+* return: uint64_t: steady_clock time in nanoseconds
+*--------------------------------------------------------*/
+uint64_t trace_now_ns();
+
+
+/*-----------------------------------------------------
+* Function: trace_thread_name
+*
+* Description: Names the calling thread's track in the trace
+*
+* param name: const char*: e.g. "worker 2"; copied
+*
+* return: void
+*--------------------------------------------------------*/
+void trace_thread_name(const char* name);
+
+
+/*-----------------------------------------------------
+* Function: trace_span
+*
+* Description: Records a finished span on the calling thread's
+* track; only the timestamp is taken unless tracing is enabled.
+* Back-to-back spans can start where the previous one ended.
+*
+* param name: const char*: span name; must outlive the trace (a literal)
+* param start_ns: uint64_t: from trace_now_ns when the span began
+* param frame: int: frame index, or -1
+*
+* return: uint64_t: the span's end, from trace_now_ns
+*--------------------------------------------------------*/
+uint64_t trace_span(const char* name, uint64_t start_ns, int frame);
+
+
+/*-----------------------------------------------------
+* Function: trace_write_json
+*
+* Description: Writes every thread's recorded spans as Chrome
+* trace-event JSON. Call once the recording threads have stopped.
+*
+* param path: const char*: output file
+*
+* return: int: number of events written, -1 if the file can't be opened
+*--------------------------------------------------------*/
+int trace_write_json(const char* path);
+
+#endif // _TRACE_HPP